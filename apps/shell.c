@@ -33,7 +33,41 @@ int run(ovs_expr e, ovs_expr args) {
 		ovs_symbol(context->root_tables + OVS_SYSTEM, u_strlen(u"exit"), u"exit").p,
 		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"cons"), u"cons").p,
 		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"des"), u"des").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"concat"), u"concat").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"substring"), u"substring").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"find"), u"find").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"split"), u"split").p,
 		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"eq"), u"eq").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"add"), u"add").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"sub"), u"sub").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"mul"), u"mul").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"divmod"), u"divmod").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"compare"), u"compare").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array"), u"array").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"float-array"), u"float-array").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-add"), u"array-add").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-sub"), u"array-sub").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-mul"), u"array-mul").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-dot"), u"array-dot").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-sum"), u"array-sum").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-min"), u"array-min").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-max"), u"array-max").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"array-prefix-sum"), u"array-prefix-sum").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"blob"), u"blob").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"decode"), u"decode").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"map"), u"map").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"map-insert"), u"map-insert").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"map-lookup"), u"map-lookup").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"map-remove"), u"map-remove").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"map-entries"), u"map-entries").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"sequence"), u"sequence").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"sequence-update"), u"sequence-update").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"sequence-concat"), u"sequence-concat").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"vector"), u"vector").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"index"), u"index").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"length"), u"length").p,
+		ovs_symbol(context->root_tables + OVS_DATA, u_strlen(u"slice"), u"slice").p,
+		ovs_symbol(context->root_tables + OVS_SYSTEM, u_strlen(u"map-file"), u"map-file").p,
 		ovs_symbol(context->root_tables + OVS_SYSTEM, u_strlen(u"in"), u"in").p,
 		ovs_symbol(context->root_tables + OVS_SYSTEM, u_strlen(u"out"), u"out").p,
 		ovs_symbol(context->root_tables + OVS_SYSTEM, u_strlen(u"err"), u"err").p
@@ -56,7 +90,41 @@ int run(ovs_expr e, ovs_expr args) {
 		ovru_exit(context),
 		ovru_cons(context, context->root_tables + OVS_UNQUALIFIED),
 		ovru_des(context, context->root_tables + OVS_UNQUALIFIED),
+		ovru_concat(context),
+		ovru_substring(context),
+		ovru_find(context),
+		ovru_split(context),
 		ovru_eq(context),
+		ovru_add(context),
+		ovru_sub(context),
+		ovru_mul(context),
+		ovru_divmod(context),
+		ovru_compare(context),
+		ovru_array(context),
+		ovru_float_array(context),
+		ovru_array_add(context),
+		ovru_array_sub(context),
+		ovru_array_mul(context),
+		ovru_array_dot(context),
+		ovru_array_sum(context),
+		ovru_array_min(context),
+		ovru_array_max(context),
+		ovru_array_prefix_sum(context),
+		ovru_blob(context),
+		ovru_decode(context),
+		ovru_map(context),
+		ovru_map_insert(context),
+		ovru_map_lookup(context),
+		ovru_map_remove(context),
+		ovru_map_entries(context),
+		ovru_sequence(context),
+		ovru_sequence_update(context),
+		ovru_sequence_concat(context),
+		ovru_vector(context, context->root_tables + OVS_UNQUALIFIED),
+		ovru_index(context),
+		ovru_length(context),
+		ovru_slice(context),
+		ovru_map_file(context),
 		ovru_open_scanner(
 				context,
 				u_finit(stdin, NULL, NULL),
@@ -84,13 +152,12 @@ int run(ovs_expr e, ovs_expr args) {
 }
 
 int run_bootstrap(ovs_expr args) {
-	UFILE* f = u_fopen("./data/bootstrap.ov", "r", NULL, NULL);
+	ovio_stream* st = ovio_open_mmap_stream("./data/bootstrap.ov");
 
-	if (f == NULL) {
+	if (st == NULL) {
 		return 123456;
 	}
 
-	ovio_stream* st = ovio_open_file_stream(f);
 	ovio_scanner* sc = ovio_open_scanner(st);
 	ovda_reader* r = ovda_open_reader(sc, context);
 
@@ -107,7 +174,6 @@ int run_bootstrap(ovs_expr args) {
 	ovda_close_reader(r);
 	ovio_close_scanner(sc);
 	ovio_close_stream(st);
-	u_fclose(f);
 
 	return result;
 }
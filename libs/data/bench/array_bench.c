@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#define ELEMENTS 1000000
+#define ITERATIONS 20
+
+double now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+ovs_expr cons_list(ovs_table* t, int32_t count) {
+	ovs_expr l = ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+	for (int32_t i = count; i-- > 0;) {
+		ovs_expr next = ovs_cons(t, ovs_integer(i % 1000), l);
+		ovs_dealias(l);
+		l = next;
+	}
+	return l;
+}
+
+/*
+ * What a fold over a cons list costs when each step goes through the
+ * same destructuring and arithmetic the builtins use.
+ */
+ovs_expr fold_sum(ovs_expr l) {
+	ovs_expr sum = ovs_integer(0);
+	ovs_expr nil = ovs_root_symbol(OVS_DATA_NIL)->expr;
+	l = ovs_alias(l);
+	while (!ovs_is_eq(l, nil)) {
+		ovs_expr head = ovs_car(l);
+		ovs_expr tail = ovs_cdr(l);
+		ovs_expr next = ovs_integer_add(sum, head);
+		ovs_dealias(sum);
+		ovs_dealias(head);
+		ovs_dealias(l);
+		sum = next;
+		l = tail;
+	}
+	ovs_dealias(l);
+	return sum;
+}
+
+ovs_expr fold_dot(ovs_expr a, ovs_expr b) {
+	ovs_expr sum = ovs_integer(0);
+	ovs_expr nil = ovs_root_symbol(OVS_DATA_NIL)->expr;
+	a = ovs_alias(a);
+	b = ovs_alias(b);
+	while (!ovs_is_eq(a, nil)) {
+		ovs_expr x = ovs_car(a);
+		ovs_expr y = ovs_car(b);
+		ovs_expr product = ovs_integer_mul(x, y);
+		ovs_expr next = ovs_integer_add(sum, product);
+		ovs_dealias(sum);
+		ovs_dealias(product);
+		sum = next;
+
+		ovs_expr tail = ovs_cdr(a);
+		ovs_dealias(a);
+		a = tail;
+		tail = ovs_cdr(b);
+		ovs_dealias(b);
+		b = tail;
+	}
+	ovs_dealias(a);
+	ovs_dealias(b);
+	return sum;
+}
+
+void report(const char* name, double list, double array) {
+	printf("%-12s  list %9.3f ms  array %9.3f ms  (%.1fx)\n",
+			name, list * 1e3, array * 1e3, list / array);
+}
+
+int main(int argc, char** argv) {
+	ovs_context* c = ovs_init();
+	ovs_table* t = &c->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr l = cons_list(t, ELEMENTS);
+	ovs_expr a;
+	ovs_expr d;
+	ovs_array_of_list(t, OVS_INT64_ARRAY, l, &a);
+	ovs_array_of_list(t, OVS_DOUBLE_ARRAY, l, &d);
+
+	printf("%i elements, %i iterations\n", ELEMENTS, ITERATIONS);
+
+	ovs_expr list_result;
+	ovs_expr array_result;
+
+	double start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		list_result = fold_sum(l);
+	}
+	double list = now() - start;
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ovs_array_sum(a, &array_result);
+	}
+	double array = now() - start;
+	report("sum", list, array);
+	if (!ovs_is_eq(list_result, array_result)) {
+		printf("sum mismatch\n");
+	}
+
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		list_result = fold_dot(l, l);
+	}
+	list = now() - start;
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ovs_array_dot(a, a, &array_result);
+	}
+	array = now() - start;
+	report("dot", list, array);
+	if (!ovs_is_eq(list_result, array_result)) {
+		printf("dot mismatch\n");
+	}
+
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ovs_array_dot(d, d, &array_result);
+	}
+	printf("%-12s  array %9.3f ms\n", "dot (double)", (now() - start) * 1e3);
+
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ovs_array_prefix_sum(a, &array_result);
+		ovs_dealias(array_result);
+	}
+	printf("%-12s  array %9.3f ms\n", "prefix sum", (now() - start) * 1e3);
+
+	ovs_dealias(l);
+	ovs_dealias(a);
+	ovs_dealias(d);
+	ovs_close(c);
+	return 0;
+}
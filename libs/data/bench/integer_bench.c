@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+/*
+ * The smallest n for which n! and the nth Fibonacci number have at least
+ * 10^5 decimal digits.
+ */
+#define FACTORIAL_N 25206
+#define FIBONACCI_N 478495
+
+double now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * The product of the integers in [from, to), multiplying halves of the
+ * range together so that the operands stay balanced.
+ */
+ovs_expr product(int64_t from, int64_t to) {
+	if (to - from == 1) {
+		return ovs_integer(from);
+	}
+	int64_t mid = from + (to - from) / 2;
+	ovs_expr a = product(from, mid);
+	ovs_expr b = product(mid, to);
+	ovs_expr p = ovs_integer_mul(a, b);
+	ovs_dealias(a);
+	ovs_dealias(b);
+	return p;
+}
+
+ovs_expr factorial(int64_t n) {
+	ovs_expr f = ovs_integer(1);
+	for (int64_t i = 2; i <= n; i++) {
+		ovs_expr next = ovs_integer_mul(f, ovs_integer(i));
+		ovs_dealias(f);
+		f = next;
+	}
+	return f;
+}
+
+/*
+ * Fibonacci by fast doubling, where
+ *
+ *   F(2k) = F(k) (2 F(k+1) - F(k))
+ *   F(2k+1) = F(k)^2 + F(k+1)^2
+ */
+ovs_expr fibonacci(int64_t n) {
+	ovs_expr a = ovs_integer(0);
+	ovs_expr b = ovs_integer(1);
+
+	for (int bit = 63 - __builtin_clzll(n); bit >= 0; bit--) {
+		ovs_expr b2 = ovs_integer_add(b, b);
+		ovs_expr d = ovs_integer_sub(b2, a);
+		ovs_expr c = ovs_integer_mul(a, d);
+		ovs_expr aa = ovs_integer_mul(a, a);
+		ovs_expr bb = ovs_integer_mul(b, b);
+		ovs_expr e = ovs_integer_add(aa, bb);
+		ovs_dealias(b2);
+		ovs_dealias(d);
+		ovs_dealias(aa);
+		ovs_dealias(bb);
+		ovs_dealias(a);
+		ovs_dealias(b);
+
+		if ((n >> bit) & 1) {
+			a = e;
+			b = ovs_integer_add(c, e);
+			ovs_dealias(c);
+		} else {
+			a = c;
+			b = e;
+		}
+	}
+
+	ovs_dealias(b);
+	return a;
+}
+
+void report(const char* name, double start, ovs_expr e) {
+	double compute = now() - start;
+
+	start = now();
+	uint32_t digits;
+	UChar* text = ovs_integer_text(e, &digits);
+	double print = now() - start;
+
+	start = now();
+	ovs_expr parsed;
+	ovs_parse_integer(digits, text, &parsed);
+	double parse = now() - start;
+
+	printf("%-20s  %6u digits  compute %9.3f ms  print %9.3f ms  parse %9.3f ms%s\n",
+			name, digits, compute * 1e3, print * 1e3, parse * 1e3,
+			ovs_is_eq(e, parsed) ? "" : "  (round trip failed)");
+
+	free(text);
+	ovs_dealias(parsed);
+	ovs_dealias(e);
+}
+
+int main(int argc, char** argv) {
+	double start = now();
+	report("factorial (tree)", start, product(1, FACTORIAL_N + 1));
+
+	start = now();
+	report("factorial (linear)", start, factorial(FACTORIAL_N));
+
+	start = now();
+	report("fibonacci", start, fibonacci(FIBONACCI_N));
+
+	return 0;
+}
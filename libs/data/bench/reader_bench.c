@@ -0,0 +1,341 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+#include <unicode/ustdio.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/io/stream.h"
+#include "c-ohvu/io/scanner.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+#include "c-ohvu/data/reader.h"
+
+#define ITERATIONS 1000
+
+double now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+UChar* load_source(const char* path, int64_t* length) {
+	UFILE* f = u_fopen(path, "r", NULL, NULL);
+	if (f == NULL) {
+		return NULL;
+	}
+
+	int64_t capacity = 4096;
+	UChar* text = malloc(sizeof(UChar) * capacity);
+	*length = 0;
+
+	int32_t read;
+	do {
+		if (*length == capacity) {
+			capacity *= 2;
+			text = realloc(text, sizeof(UChar) * capacity);
+		}
+		read = u_file_read(text + *length, capacity - *length, f);
+		*length += read;
+	} while (read > 0);
+
+	u_fclose(f);
+	return text;
+}
+
+ovda_result read_source(ovs_context* c, const UChar* text, int64_t length, ovs_expr* e) {
+	ovio_stream* st = ovio_open_nustring_stream(text, length);
+	ovio_scanner* sc = ovio_open_scanner(st);
+	ovda_reader* r = ovda_open_reader(sc, c);
+
+	ovda_result result = ovda_read(r, e);
+
+	ovda_close_reader(r);
+	ovio_close_scanner(sc);
+	ovio_close_stream(st);
+
+	return result;
+}
+
+/*
+ * Read the same program repeatedly, then compare every copy with the
+ * first. With hash consing the copies share storage, so comparison is an
+ * identity check.
+ */
+void bench_hash_cons(const UChar* text, int64_t length, bool hash_cons) {
+	ovs_context* c = ovs_init();
+	ovs_table_hash_cons(&c->root_tables[OVS_UNQUALIFIED], hash_cons);
+
+	ovs_expr* copies = malloc(sizeof(ovs_expr) * ITERATIONS);
+
+	double start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		if (read_source(c, text, length, &copies[i]) != OVDA_SUCCESS) {
+			printf("failed to read source\n");
+			exit(1);
+		}
+	}
+	double read = now() - start;
+
+	start = now();
+	int32_t equal = 0;
+	for (int i = 0; i < ITERATIONS; i++) {
+		equal += ovs_is_eq(copies[0], copies[i]);
+	}
+	double eq = now() - start;
+
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ovs_dealias(copies[i]);
+	}
+	double dealias = now() - start;
+
+	printf("hash consing %-3s  read %8.3f ms  eq %8.3f ms  free %8.3f ms  (%i/%i equal)\n",
+			hash_cons ? "on" : "off",
+			read * 1e3, eq * 1e3, dealias * 1e3,
+			equal, ITERATIONS);
+
+	free(copies);
+	ovs_close(c);
+}
+
+/*
+ * Read the file from disk each time, through the stream which copies
+ * blocks out of a UFILE and through the one which maps the file.
+ */
+void bench_streams(const char* path) {
+	ovs_context* c = ovs_init();
+
+	double file = 0;
+	double mapped = 0;
+	for (int i = 0; i < ITERATIONS; i++) {
+		double start = now();
+		UFILE* f = u_fopen(path, "r", NULL, NULL);
+		ovio_stream* st = ovio_open_file_stream(f);
+		ovio_scanner* sc = ovio_open_scanner(st);
+		ovda_reader* r = ovda_open_reader(sc, c);
+		ovs_expr e;
+		ovda_read(r, &e);
+		ovs_dealias(e);
+		ovda_close_reader(r);
+		ovio_close_scanner(sc);
+		ovio_close_stream(st);
+		u_fclose(f);
+		file += now() - start;
+
+		start = now();
+		st = ovio_open_mmap_stream(path);
+		sc = ovio_open_scanner(st);
+		r = ovda_open_reader(sc, c);
+		ovda_read(r, &e);
+		ovs_dealias(e);
+		ovda_close_reader(r);
+		ovio_close_scanner(sc);
+		ovio_close_stream(st);
+		mapped += now() - start;
+	}
+
+	printf("file stream %8.3f ms  mmap stream %8.3f ms\n", file * 1e3, mapped * 1e3);
+
+	ovs_close(c);
+}
+
+/*
+ * A synthetic data file of nested lists of records, each a list of
+ * symbols, qualified symbols, integers and strings, with the occasional
+ * comment.
+ */
+void append_corpus(char** s, int64_t* length, int64_t* capacity, const char* text) {
+	int64_t n = strlen(text);
+	if (*length + n > *capacity) {
+		*capacity = 2 * (*length + n);
+		*s = realloc(*s, *capacity);
+	}
+	memcpy(*s + *length, text, n);
+	*length += n;
+}
+
+char* generate_corpus(int32_t fanout, int64_t* length) {
+	static const char* names[] = { "alpha", "beta", "gamma", "delta", "data/lambda", "system/out", "résumé", "naïve" };
+	static const char* strings[] = { "\"hello world\"", "\"\"", "\"a (quoted) string; not a comment\"", "\"€ and 𝄞\"" };
+
+	int64_t capacity = 1 << 20;
+	char* s = malloc(capacity);
+	*length = 0;
+
+	uint32_t seed = 1;
+	char field[32];
+	append_corpus(&s, length, &capacity, "(");
+	for (int32_t i = 0; i < fanout; i++) {
+		append_corpus(&s, length, &capacity, "\n (");
+		for (int32_t j = 0; j < fanout; j++) {
+			append_corpus(&s, length, &capacity, j % 16 == 0 ? "\n  ; a group of records\n  (" : "\n  (");
+			for (int32_t k = 0; k < fanout; k++) {
+				seed = seed * 1103515245 + 12345;
+				snprintf(field, sizeof(field), "%i", (int32_t)(seed >> 8) % 100000);
+				append_corpus(&s, length, &capacity, "(");
+				append_corpus(&s, length, &capacity, names[seed % 8]);
+				append_corpus(&s, length, &capacity, " ");
+				append_corpus(&s, length, &capacity, field);
+				append_corpus(&s, length, &capacity, " ");
+				append_corpus(&s, length, &capacity, strings[(seed >> 4) % 4]);
+				append_corpus(&s, length, &capacity, " '(x y) . z) ");
+			}
+			append_corpus(&s, length, &capacity, ")");
+		}
+		append_corpus(&s, length, &capacity, ")");
+	}
+	append_corpus(&s, length, &capacity, ")\n");
+	return s;
+}
+
+/*
+ * Read the same UTF-8 corpus through a scanner and through the structural
+ * index, and check that both give the same expression.
+ */
+void bench_indexed(int32_t fanout, int32_t iterations) {
+	ovs_context* c = ovs_init();
+
+	int64_t length;
+	char* corpus = generate_corpus(fanout, &length);
+
+	ovs_expr scanned;
+	double scanner = 0;
+	for (int i = 0; i < iterations; i++) {
+		if (i > 0) {
+			ovs_dealias(scanned);
+		}
+		double start = now();
+		ovio_stream* st = ovio_open_nstring_stream(corpus, length);
+		ovio_scanner* sc = ovio_open_scanner(st);
+		ovda_reader* r = ovda_open_reader(sc, c);
+		if (ovda_read(r, &scanned) != OVDA_SUCCESS) {
+			printf("failed to read corpus\n");
+			exit(1);
+		}
+		ovda_close_reader(r);
+		ovio_close_scanner(sc);
+		ovio_close_stream(st);
+		scanner += now() - start;
+	}
+
+	ovs_expr indexed;
+	double index = 0;
+	for (int i = 0; i < iterations; i++) {
+		if (i > 0) {
+			ovs_dealias(indexed);
+		}
+		double start = now();
+		if (ovda_read_indexed(c, corpus, length, &indexed) != OVDA_SUCCESS) {
+			printf("failed to read corpus from index\n");
+			exit(1);
+		}
+		index += now() - start;
+	}
+
+	double gigabytes = (double)length * iterations / 1e9;
+	printf("corpus %.1f MB  scanner %6.3f GB/s  indexed %6.3f GB/s  (%s)\n",
+			length / 1e6, gigabytes / scanner, gigabytes / index,
+			ovs_is_eq(scanned, indexed) ? "equal" : "different");
+
+	ovs_dealias(scanned);
+	ovs_dealias(indexed);
+	free(corpus);
+	ovs_close(c);
+}
+
+/*
+ * Read a long list one atom at a time, which allocates nothing, so that
+ * the time is spent telling tokens apart rather than building lists.
+ */
+void bench_tokens(int32_t count, int32_t iterations) {
+	static const char* atoms[] = { "alpha", "beta", "résumé", "12345", "-7", "x.y", "naïve", "0" };
+	static const char* spaces[] = { " ", "\n  ", "\t", " ; a comment\n " };
+
+	ovs_context* c = ovs_init();
+
+	int64_t length = 0;
+	int64_t capacity = 1 << 20;
+	char* text = malloc(capacity);
+	uint32_t seed = 1;
+	append_corpus(&text, &length, &capacity, "(");
+	for (int32_t i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		append_corpus(&text, &length, &capacity, atoms[(seed >> 8) % 8]);
+		append_corpus(&text, &length, &capacity, spaces[(seed >> 16) % 16 == 0 ? 3 : (seed >> 12) % 3]);
+	}
+	append_corpus(&text, &length, &capacity, ")");
+
+	/*
+	 * Hold on to every atom once so that its symbol stays interned, as it
+	 * would while reading any real source.
+	 */
+	ovs_expr held;
+	ovio_stream* st = ovio_open_nstring_stream(text, length);
+	ovio_scanner* sc = ovio_open_scanner(st);
+	ovda_reader* r = ovda_open_reader(sc, c);
+	ovda_read(r, &held);
+	ovda_close_reader(r);
+	ovio_close_scanner(sc);
+	ovio_close_stream(st);
+
+	double elapsed = 0;
+	int64_t atoms_read = 0;
+	for (int i = 0; i < iterations; i++) {
+		double start = now();
+		st = ovio_open_nstring_stream(text, length);
+		sc = ovio_open_scanner(st);
+		r = ovda_open_reader(sc, c);
+		ovs_expr e;
+		ovda_read_step_in(r);
+		while (ovda_read(r, &e) == OVDA_SUCCESS) {
+			ovs_dealias(e);
+			atoms_read++;
+		}
+		ovda_read_step_out(r, &e);
+		ovs_dealias(e);
+		ovda_close_reader(r);
+		ovio_close_scanner(sc);
+		ovio_close_stream(st);
+		elapsed += now() - start;
+	}
+
+	printf("tokens %.1f MB  %6.3f GB/s  (%s)\n",
+			length / 1e6, (double)length * iterations / 1e9 / elapsed,
+			atoms_read == (int64_t)count * iterations ? "complete" : "incomplete");
+
+	ovs_dealias(held);
+	free(text);
+	ovs_close(c);
+}
+
+int main(int argc, char** argv) {
+	const char* path = argc > 1 ? argv[1] : OVDA_BENCH_DATA;
+
+	int64_t length;
+	UChar* text = load_source(path, &length);
+	if (text == NULL) {
+		printf("cannot open %s\n", path);
+		return 1;
+	}
+
+	printf("%s: %li characters, %i iterations\n", path, length, ITERATIONS);
+
+	bench_hash_cons(text, length, false);
+	bench_hash_cons(text, length, true);
+	bench_streams(path);
+	bench_indexed(64, 5);
+	bench_tokens(2000000, 5);
+
+	free(text);
+	return 0;
+}
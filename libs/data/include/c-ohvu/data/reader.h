@@ -1,22 +1,84 @@
 typedef enum ovda_result {
 	OVDA_SUCCESS,
 	OVDA_UNEXPECTED_TYPE,
-	OVDA_INVALID
+	OVDA_INVALID,
+	OVDA_NEED_INPUT
 } ovda_result;
 
-typedef struct ovda_cursor_stack {
+/**
+ * The next step of a read, which is kept on the reader so that in push
+ * mode a read can stop between steps and carry on when more input comes.
+ */
+typedef enum ovda_step {
+	OVDA_STEP_SKIP,
+	OVDA_STEP_VALUE,
+	OVDA_STEP_TAIL,
+	OVDA_STEP_OPENED,
+	OVDA_STEP_NEXT,
+	OVDA_STEP_CLOSE
+} ovda_step;
+
+/**
+ * The position of a cursor counts the expressions read at its depth. A
+ * cursor for a list also records where its elements start on the value
+ * stack, how many quotes enclose it, and whether a dot has been read.
+ */
+typedef struct ovda_cursor {
 	int64_t position;
-	struct ovda_cursor_stack* stack;
+	int32_t first;
+	int32_t quotes;
+	bool dotted;
+} ovda_cursor;
+
+typedef struct ovda_cursor_stack {
+	ovda_cursor* cursors;
+	int32_t depth;
+	int32_t capacity;
 } ovda_cursor_stack;
 
+/**
+ * Input fed to a reader in push mode, held as UTF-16 from the start of the
+ * step it is part way through. An incomplete UTF-8 sequence at the end of
+ * a block is held back until the next one. If the step stopped in a run
+ * of some class of characters, such as the body of a string, the class
+ * is kept along with how far the text was scanned.
+ */
+typedef struct ovda_fed_input {
+	UChar* text;
+	int64_t length;
+	int64_t capacity;
+	int64_t start;
+	int64_t read;
+	uint8_t partial[4];
+	int32_t partial_length;
+	bool ended;
+	const ovio_class* run;
+	int64_t scanned;
+} ovda_fed_input;
+
 typedef struct ovda_reader {
 	ovda_cursor_stack cursor;
+	ovda_step step;
+	int32_t quotes;
+	ovda_fed_input* fed;
 	ovio_scanner* scanner;
 	ovs_context* context;
+	ovs_expr* values;
+	int32_t value_count;
+	int32_t value_capacity;
+	UChar* scratch;
+	int32_t scratch_capacity;
 } ovda_reader;
 
 ovda_reader* ovda_open_reader(ovio_scanner* s, ovs_context* c);
 
+/**
+ * Open a reader in push mode, which takes its input from blocks handed to
+ * ovda_feed rather than pulling it from a scanner. Only ovda_feed and
+ * ovda_read may be used on it.
+ */
+ovda_reader* ovda_open_push_reader(ovs_context* c);
+
 void ovda_close_reader(ovda_reader* r);
 
 int64_t ovda_cursor_position(ovda_reader* r, int32_t inputDepth);
@@ -25,6 +87,26 @@ int32_t ovda_cursor_depth(ovda_reader* r);
 
 ovda_result ovda_read(ovda_reader* r, ovs_expr* e);
 
+/**
+ * Hand the next block of input to a reader in push mode, or NULL once the
+ * input has ended, and read the next expression. The block is copied, so
+ * it may be reused as soon as this returns.
+ *
+ * If the input so far runs out part way through an expression the result
+ * is OVDA_NEED_INPUT, and the read carries on from where it stopped when
+ * the next block is fed. One block may complete several expressions, and
+ * those after the first are had by calling ovda_read until it too needs
+ * more input.
+ */
+ovda_result ovda_feed(ovda_reader* r, const ovio_block* b, ovs_expr* e);
+
+/**
+ * Read the first expression from a buffer of UTF-8, with the same result
+ * as ovda_read, by indexing the structure of the input a window at a time
+ * and building from the index.
+ */
+ovda_result ovda_read_indexed(ovs_context* c, const char* s, int64_t length, ovs_expr* e);
+
 ovda_result ovda_read_symbol(ovda_reader* r, ovs_expr* e);
 
 ovda_result ovda_read_step_in(ovda_reader* r);
@@ -1,20 +1,43 @@
 typedef enum ovs_expr_type {
 	OVS_SYMBOL,
 	OVS_CONS,
+	OVS_LIST,
+	OVS_VECTOR,
 	OVS_FUNCTION,
 	OVS_CHARACTER,
 	OVS_STRING,
+	OVS_SHORT_STRING,
 	OVS_INTEGER,
-	OVS_BIG_INTEGER
+	OVS_BIG_INTEGER,
+	OVS_FLOAT,
+	OVS_ARRAY,
+	OVS_BLOB,
+	OVS_MAP,
+	OVS_SEQUENCE
 } ovs_expr_type;
 
 typedef struct ovs_expr_ref ovs_expr_ref;
 
+/*
+ * Strings of up to OVS_SHORT_STRING_MAX code units are stored inline in
+ * the expression rather than on the heap. Every string which fits is
+ * stored this way, so a heap string is never equal to a short string.
+ */
+#define OVS_SHORT_STRING_MAX 3
+
+typedef struct ovs_short_string {
+	UChar string[OVS_SHORT_STRING_MAX];
+	uint16_t length;
+} ovs_short_string;
+
 typedef struct ovs_expr {
 	ovs_expr_type type;
+	uint32_t offset; // index into the elements of an OVS_LIST or OVS_VECTOR
 	union {
 		UChar32 character;
+		ovs_short_string short_string;
 		int64_t integer;
+		double floating;
 		ovs_expr_ref const* p;
 	};
 } ovs_expr;
@@ -38,9 +61,12 @@ typedef enum ovs_root_table {
 } ovs_root_table;
 #define OVS_ROOT_TABLE_COUNT (OVS_TEXT_CHARACTER + 1)
 
+struct ovs_cons_set;
+
 typedef struct ovs_table {
 	bdtrie trie;
 	ovs_expr_ref* qualifier;
+	struct ovs_cons_set* conses; // non-NULL when hash consing
 } ovs_table;
 
 typedef struct ovs_context {
@@ -61,6 +87,31 @@ typedef struct ovs_cons_data {
 	ovs_expr cdr;
 } ovs_cons_data;
 
+/*
+ * A run of list cells stored contiguously, cdr-coded. An OVS_LIST
+ * expression refers to the suffix starting at its offset, and the cdr of
+ * the last element is the shared tail.
+ */
+typedef struct ovs_list_data {
+	ovs_table* table;
+	uint32_t size;
+	ovs_expr tail;
+	ovs_expr elements[1]; // variable length
+} ovs_list_data;
+
+/*
+ * An immutable array of expressions. An OVS_VECTOR expression refers to
+ * the elements from its offset to the end, and is viewed as an
+ * unqualified list of those elements, so an empty vector is nil. A slice
+ * which ends before the end of its base shares the base's elements.
+ */
+typedef struct ovs_vector_data {
+	uint32_t size;
+	ovs_expr* elements;
+	const ovs_expr_ref* base; // owner of the elements of a slice, otherwise NULL
+	ovs_expr storage[1]; // variable length, unless this is a slice
+} ovs_vector_data;
+
 typedef struct ovs_function_info {
 	uint32_t arg_count;
 	uint32_t max_result_size;
@@ -70,6 +121,7 @@ struct ovs_function_data;
 
 typedef struct ovs_function_type {
 	UChar* name;
+	// must not need the representation of the function it is given
 	ovs_expr (*represent)(const struct ovs_function_data* d);
 	ovs_function_info (*inspect)(const struct ovs_function_data* d);
 	int32_t (*apply)(ovs_instruction* result,  ovs_expr* args, const struct ovs_function_data* d);
@@ -79,20 +131,138 @@ typedef struct ovs_function_type {
 typedef struct ovs_function_data {
 	ovs_function_type* type;
 	ovs_context* context;
+
+	// memoized on first use, along with traits derived from it, which
+	// are only read once the state in represented says they are built
+	_Atomic(int32_t) represented;
+	bool symbolic;
+	ovs_table* table;
+	ovs_expr representation;
+
 	// variable length data
 } ovs_function_data;
 
 typedef struct ovs_string_data {
-	UChar string[1]; // variable length
+	uint32_t length;
+	UChar string[1]; // variable length, NUL terminated but may contain NULs
 } ovs_string_data;
 
+/*
+ * Accumulates a string in a buffer which grows geometrically, and which
+ * becomes the storage of the finished string.
+ */
+typedef struct ovs_string_builder {
+	uint32_t capacity;
+	ovs_expr_ref* r;
+} ovs_string_builder;
+
+/*
+ * The magnitude of an integer which does not fit an int64_t, as base 2^32
+ * limbs from least significant, with no leading zero limbs. Every integer
+ * which fits is an unboxed OVS_INTEGER instead.
+ */
+typedef struct ovs_big_integer_data {
+	uint32_t size;
+	bool negative;
+	uint32_t limbs[1]; // variable length
+} ovs_big_integer_data;
+
+typedef enum ovs_array_kind {
+	OVS_INT64_ARRAY,
+	OVS_DOUBLE_ARRAY
+} ovs_array_kind;
+
+/*
+ * A packed homogeneous array of numbers, for which arithmetic on int64
+ * elements wraps rather than promoting.
+ */
+typedef struct ovs_array_data {
+	ovs_array_kind kind;
+	uint32_t size;
+	union {
+		int64_t int64s[1]; // variable length
+		double doubles[1]; // variable length
+	};
+} ovs_array_data;
+
+/*
+ * An immutable run of bytes. The bytes of a slice belong to its base, and
+ * those of a mapped blob to a region from mmap which is unmapped when the
+ * blob is released.
+ */
+typedef struct ovs_blob_data {
+	uint64_t size;
+	const uint8_t* bytes;
+	const ovs_expr_ref* base; // owner of the bytes of a slice, otherwise NULL
+	uint64_t mapped; // length of the mapping, or zero if not mapped
+	uint8_t storage[1]; // variable length, unless this is a slice or mapped
+} ovs_blob_data;
+
+/*
+ * A node of a persistent hash map, as a compressed hash array mapped
+ * trie. Each level takes five bits of the key hash to choose one of 32
+ * positions, each holding either an entry or a subnode. The slots hold
+ * the entries first as key value pairs, then the subnodes, both in
+ * position order, and a subnode always holds at least two entries, so
+ * equal maps have the same shape. Keys with identical hashes share a
+ * collision node, which has neither map and holds its entries unordered.
+ */
+typedef struct ovs_map_data {
+	uint32_t count; // entries in this node and its subnodes
+	uint32_t datamap;
+	uint32_t nodemap;
+	uint32_t entries;
+	uint32_t nodes;
+	ovs_expr slots[1]; // variable length
+} ovs_map_data;
+
+#define OVS_MAP_DEPTH 8
+
+typedef struct ovs_map_iterator {
+	uint32_t depth;
+	const ovs_expr_ref* nodes[OVS_MAP_DEPTH];
+	uint32_t positions[OVS_MAP_DEPTH];
+} ovs_map_iterator;
+
+/*
+ * A node of a persistent sequence, as a relaxed radix balanced tree. A
+ * leaf holds up to 32 elements and an inner node up to 32 subnodes of the
+ * height below. Inner nodes record the cumulative sizes of their subnodes
+ * after their slots. A node is relaxed unless every subnode but the last
+ * is full, in which case the path to an index is read off its digits in
+ * base 32 without consulting the sizes.
+ */
+typedef struct ovs_sequence_data {
+	uint32_t size; // elements in this node and its subnodes
+	uint8_t height; // zero for a leaf
+	uint8_t count;
+	uint8_t capacity;
+	bool relaxed;
+	ovs_expr slots[1]; // variable length, followed by sizes in an inner node
+} ovs_sequence_data;
+
+typedef struct ovs_sequence_iterator {
+	const ovs_expr_ref* root;
+	const ovs_expr_ref* leaf;
+	uint32_t index;
+	uint32_t position; // within the current leaf
+} ovs_sequence_iterator;
+
 struct ovs_expr_ref {
 	_Atomic(uint32_t) ref_count;
+	_Atomic(uint32_t) hash; // zero until first computed by ovs_hash
 	union {
 		ovs_symbol_data symbol;
 		ovs_cons_data cons;
+		ovs_list_data list;
+		ovs_vector_data vector;
 		ovs_function_data function;
 		ovs_string_data string;
+		ovs_big_integer_data big_integer;
+		ovs_array_data array;
+		ovs_blob_data blob;
+		ovs_map_data map;
+		ovs_sequence_data sequence;
 	};
 };
 
@@ -114,25 +284,102 @@ void ovs_close(ovs_context* c);
 ovs_table* ovs_table_for(ovs_context* c, const ovs_expr_ref* r);
 ovs_table* ovs_table_of(ovs_context* c, const ovs_expr e);
 ovs_context* ovs_context_of(ovs_table* t);
+void ovs_table_hash_cons(ovs_table* t, bool enabled);
 
 ovs_expr ovs_symbol(ovs_table* t, uint32_t l, UChar* name);
 ovs_root_symbol_data* ovs_root_symbol(ovs_root_table t);
 ovs_expr ovs_cons(ovs_table* t, ovs_expr car, ovs_expr cdr);
 ovs_expr ovs_character(UChar32 c);
+ovs_expr ovs_integer(int64_t i);
+ovs_expr ovs_float(double d);
+bool ovs_parse_integer(uint32_t l, const UChar* s, ovs_expr* e);
+UChar* ovs_integer_text(ovs_expr e, uint32_t* length);
 ovs_expr ovs_string(uint32_t l, UChar* s);
 ovs_expr ovs_cstring(UConverter* c, char* s);
+const UChar* ovs_string_chars(const ovs_expr* e, uint32_t* length);
+void ovs_string_builder_init(ovs_string_builder* b);
+void ovs_string_builder_append(ovs_string_builder* b, uint32_t l, const UChar* s);
+void ovs_string_builder_append_string(ovs_string_builder* b, ovs_expr s);
+ovs_expr ovs_string_builder_finish(ovs_string_builder* b);
+ovs_expr ovs_substring(ovs_expr s, uint32_t from, uint32_t to);
+bool ovs_string_find(ovs_expr s, ovs_expr pattern, uint32_t from, uint32_t* index);
+int32_t ovs_string_compare(ovs_expr a, ovs_expr b);
+ovs_expr ovs_string_split(ovs_table* t, ovs_expr s, ovs_expr separator);
 ovs_expr ovs_function(ovs_context* c, ovs_function_type* t, uint32_t extra_data_size, void** extra_data);
 void* ovs_function_extra_data(const ovs_function_data* d);
+ovs_expr ovs_function_representation(const ovs_function_data* d);
 
 ovs_expr ovs_list(ovs_table* t, int32_t count, ovs_expr* e);
 ovs_expr ovs_list_of(ovs_table* t, int32_t count, void** e, ovs_expr (*map)(const void* elem));
+int32_t ovs_list_length(ovs_table* t, ovs_expr l);
+int32_t ovs_delist_into(ovs_table* t, ovs_expr l, int32_t count, ovs_expr* e);
 int32_t ovs_delist(ovs_table* t, ovs_expr l, ovs_expr** e); 
 int32_t ovs_delist_of(ovs_table* t, ovs_expr l, void*** e, void* (*map)(ovs_expr elem)); 
 
+bool ovs_is_integer(ovs_expr e);
+ovs_expr ovs_integer_add(ovs_expr a, ovs_expr b);
+ovs_expr ovs_integer_sub(ovs_expr a, ovs_expr b);
+ovs_expr ovs_integer_mul(ovs_expr a, ovs_expr b);
+bool ovs_integer_divmod(ovs_expr a, ovs_expr b, ovs_expr* q, ovs_expr* r);
+int32_t ovs_integer_compare(ovs_expr a, ovs_expr b);
+
+ovs_expr ovs_vector(int32_t count, ovs_expr* e);
+int32_t ovs_vector_of_list(ovs_table* t, ovs_expr l, ovs_expr* v);
+bool ovs_is_vector(ovs_expr e);
+uint32_t ovs_vector_length(ovs_expr v);
+ovs_expr ovs_vector_index(ovs_expr v, uint32_t i);
+ovs_expr ovs_vector_slice(ovs_expr v, uint32_t from, uint32_t to);
+
+ovs_expr ovs_array(ovs_array_kind kind, uint32_t size, void** elements);
+int32_t ovs_array_of_list(ovs_table* t, ovs_array_kind kind, ovs_expr l, ovs_expr* a);
+bool ovs_is_array(ovs_expr e);
+uint32_t ovs_array_length(ovs_expr a);
+ovs_expr ovs_array_index(ovs_expr a, uint32_t i);
+bool ovs_array_add(ovs_expr a, ovs_expr b, ovs_expr* r);
+bool ovs_array_sub(ovs_expr a, ovs_expr b, ovs_expr* r);
+bool ovs_array_mul(ovs_expr a, ovs_expr b, ovs_expr* r);
+bool ovs_array_dot(ovs_expr a, ovs_expr b, ovs_expr* r);
+bool ovs_array_sum(ovs_expr a, ovs_expr* r);
+bool ovs_array_min(ovs_expr a, ovs_expr* r);
+bool ovs_array_max(ovs_expr a, ovs_expr* r);
+bool ovs_array_prefix_sum(ovs_expr a, ovs_expr* r);
+
+ovs_expr ovs_blob(uint64_t size, const uint8_t* bytes);
+bool ovs_blob_map_file(const char* path, ovs_expr* b);
+bool ovs_is_blob(ovs_expr e);
+uint64_t ovs_blob_length(ovs_expr b);
+const uint8_t* ovs_blob_bytes(ovs_expr b);
+ovs_expr ovs_blob_slice(ovs_expr b, uint64_t from, uint64_t to);
+bool ovs_blob_decode(ovs_expr b, ovs_expr* s);
+
+ovs_expr ovs_map();
+bool ovs_is_map(ovs_expr e);
+uint32_t ovs_map_count(ovs_expr m);
+bool ovs_map_lookup(ovs_expr m, ovs_expr key, ovs_expr* value);
+ovs_expr ovs_map_insert(ovs_expr m, ovs_expr key, ovs_expr value);
+ovs_expr ovs_map_remove(ovs_expr m, ovs_expr key);
+void ovs_map_iterate(ovs_expr m, ovs_map_iterator* i);
+bool ovs_map_next(ovs_map_iterator* i, ovs_expr* key, ovs_expr* value);
+
+ovs_expr ovs_sequence(uint32_t count, ovs_expr* e);
+int32_t ovs_sequence_of_list(ovs_table* t, ovs_expr l, ovs_expr* s);
+bool ovs_is_sequence(ovs_expr e);
+uint32_t ovs_sequence_length(ovs_expr s);
+ovs_expr ovs_sequence_index(ovs_expr s, uint32_t i);
+ovs_expr ovs_sequence_update(ovs_expr s, uint32_t i, ovs_expr e);
+ovs_expr ovs_sequence_concat(ovs_expr a, ovs_expr b);
+ovs_expr ovs_sequence_slice(ovs_expr s, uint32_t from, uint32_t to);
+void ovs_sequence_set(ovs_expr* s, uint32_t i, ovs_expr e);
+void ovs_sequence_push(ovs_expr* s, ovs_expr e);
+void ovs_sequence_iterate(ovs_expr s, ovs_sequence_iterator* i);
+bool ovs_sequence_next(ovs_sequence_iterator* i, ovs_expr* e);
+
 bool ovs_is_atom(ovs_table* t, ovs_expr e);
 bool ovs_is_qualified(ovs_expr e);
 bool ovs_is_symbol(ovs_expr e);
+bool ovs_is_string(ovs_expr e);
 bool ovs_is_eq(ovs_expr a, ovs_expr b);
+uint32_t ovs_hash(ovs_expr e);
 
 ovs_expr ovs_qualifier(ovs_expr e);
 UChar* ovs_name(ovs_expr e);
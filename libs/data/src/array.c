@@ -0,0 +1,570 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OVS_ARRAY_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+ * Kernels over packed elements. Every kernel has a portable version, and
+ * on x86-64 an AVX2 version which is selected at runtime if the CPU
+ * supports it. Int64 arithmetic wraps, and reductions over doubles may
+ * associate differently from a sequential loop.
+ */
+typedef struct array_kernels {
+	void (*add_int64)(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n);
+	void (*sub_int64)(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n);
+	void (*mul_int64)(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n);
+	int64_t (*dot_int64)(const int64_t* a, const int64_t* b, uint32_t n);
+	int64_t (*sum_int64)(const int64_t* a, uint32_t n);
+	int64_t (*min_int64)(const int64_t* a, uint32_t n);
+	int64_t (*max_int64)(const int64_t* a, uint32_t n);
+	void (*prefix_sum_int64)(const int64_t* a, int64_t* r, uint32_t n);
+
+	void (*add_double)(const double* a, const double* b, double* r, uint32_t n);
+	void (*sub_double)(const double* a, const double* b, double* r, uint32_t n);
+	void (*mul_double)(const double* a, const double* b, double* r, uint32_t n);
+	double (*dot_double)(const double* a, const double* b, uint32_t n);
+	double (*sum_double)(const double* a, uint32_t n);
+	double (*min_double)(const double* a, uint32_t n);
+	double (*max_double)(const double* a, uint32_t n);
+	void (*prefix_sum_double)(const double* a, double* r, uint32_t n);
+} array_kernels;
+
+/*
+ * Portable kernels
+ */
+
+void add_int64(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		r[i] = (uint64_t)a[i] + (uint64_t)b[i];
+	}
+}
+
+void sub_int64(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		r[i] = (uint64_t)a[i] - (uint64_t)b[i];
+	}
+}
+
+void mul_int64(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		r[i] = (uint64_t)a[i] * (uint64_t)b[i];
+	}
+}
+
+int64_t dot_int64(const int64_t* a, const int64_t* b, uint32_t n) {
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		sum += (uint64_t)a[i] * (uint64_t)b[i];
+	}
+	return sum;
+}
+
+int64_t sum_int64(const int64_t* a, uint32_t n) {
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		sum += a[i];
+	}
+	return sum;
+}
+
+int64_t min_int64(const int64_t* a, uint32_t n) {
+	int64_t m = a[0];
+	for (uint32_t i = 1; i < n; i++) {
+		m = a[i] < m ? a[i] : m;
+	}
+	return m;
+}
+
+int64_t max_int64(const int64_t* a, uint32_t n) {
+	int64_t m = a[0];
+	for (uint32_t i = 1; i < n; i++) {
+		m = a[i] > m ? a[i] : m;
+	}
+	return m;
+}
+
+void prefix_sum_int64(const int64_t* a, int64_t* r, uint32_t n) {
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		sum += a[i];
+		r[i] = sum;
+	}
+}
+
+void add_double(const double* a, const double* b, double* r, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		r[i] = a[i] + b[i];
+	}
+}
+
+void sub_double(const double* a, const double* b, double* r, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		r[i] = a[i] - b[i];
+	}
+}
+
+void mul_double(const double* a, const double* b, double* r, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		r[i] = a[i] * b[i];
+	}
+}
+
+double dot_double(const double* a, const double* b, uint32_t n) {
+	double sum = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+double sum_double(const double* a, uint32_t n) {
+	double sum = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		sum += a[i];
+	}
+	return sum;
+}
+
+double min_double(const double* a, uint32_t n) {
+	double m = a[0];
+	for (uint32_t i = 1; i < n; i++) {
+		m = a[i] < m ? a[i] : m;
+	}
+	return m;
+}
+
+double max_double(const double* a, uint32_t n) {
+	double m = a[0];
+	for (uint32_t i = 1; i < n; i++) {
+		m = a[i] > m ? a[i] : m;
+	}
+	return m;
+}
+
+void prefix_sum_double(const double* a, double* r, uint32_t n) {
+	double sum = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		sum += a[i];
+		r[i] = sum;
+	}
+}
+
+static const array_kernels portable_kernels = {
+	add_int64,
+	sub_int64,
+	mul_int64,
+	dot_int64,
+	sum_int64,
+	min_int64,
+	max_int64,
+	prefix_sum_int64,
+	add_double,
+	sub_double,
+	mul_double,
+	dot_double,
+	sum_double,
+	min_double,
+	max_double,
+	prefix_sum_double
+};
+
+#ifdef OVS_ARRAY_AVX2
+
+/*
+ * AVX2 kernels, four elements at a time with a portable tail
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i mul_epi64(__m256i a, __m256i b) {
+	// the low 64 bits of the product from three 32 bit multiplies
+	__m256i lo = _mm256_mul_epu32(a, b);
+	__m256i cross = _mm256_add_epi64(
+			_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)),
+			_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b));
+	return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+AVX2 static inline int64_t hsum_epi64(__m256i v) {
+	__m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	return (uint64_t)_mm_cvtsi128_si64(s) + (uint64_t)_mm_extract_epi64(s, 1);
+}
+
+AVX2 static inline double hsum_pd(__m256d v) {
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+AVX2 void add_int64_avx2(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n) {
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(r + i), _mm256_add_epi64(x, y));
+	}
+	add_int64(a + i, b + i, r + i, n - i);
+}
+
+AVX2 void sub_int64_avx2(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n) {
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(r + i), _mm256_sub_epi64(x, y));
+	}
+	sub_int64(a + i, b + i, r + i, n - i);
+}
+
+AVX2 void mul_int64_avx2(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n) {
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(r + i), mul_epi64(x, y));
+	}
+	mul_int64(a + i, b + i, r + i, n - i);
+}
+
+AVX2 int64_t dot_int64_avx2(const int64_t* a, const int64_t* b, uint32_t n) {
+	__m256i sum = _mm256_setzero_si256();
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+		sum = _mm256_add_epi64(sum, mul_epi64(x, y));
+	}
+	return (uint64_t)hsum_epi64(sum) + (uint64_t)dot_int64(a + i, b + i, n - i);
+}
+
+AVX2 int64_t sum_int64_avx2(const int64_t* a, uint32_t n) {
+	__m256i sum0 = _mm256_setzero_si256();
+	__m256i sum1 = _mm256_setzero_si256();
+	uint32_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256((const __m256i*)(a + i)));
+		sum1 = _mm256_add_epi64(sum1, _mm256_loadu_si256((const __m256i*)(a + i + 4)));
+	}
+	return (uint64_t)hsum_epi64(_mm256_add_epi64(sum0, sum1)) + (uint64_t)sum_int64(a + i, n - i);
+}
+
+AVX2 int64_t min_int64_avx2(const int64_t* a, uint32_t n) {
+	if (n < 4) {
+		return min_int64(a, n);
+	}
+	__m256i m = _mm256_loadu_si256((const __m256i*)a);
+	uint32_t i = 4;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(m, x));
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	int64_t result = min_int64(lanes, 4);
+	return i < n ? min_int64((int64_t[]){ result, min_int64(a + i, n - i) }, 2) : result;
+}
+
+AVX2 int64_t max_int64_avx2(const int64_t* a, uint32_t n) {
+	if (n < 4) {
+		return max_int64(a, n);
+	}
+	__m256i m = _mm256_loadu_si256((const __m256i*)a);
+	uint32_t i = 4;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(x, m));
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	int64_t result = max_int64(lanes, 4);
+	return i < n ? max_int64((int64_t[]){ result, max_int64(a + i, n - i) }, 2) : result;
+}
+
+/*
+ * Each block of four is scanned in register by adding copies of itself
+ * shifted up one then two lanes, then offset by the running total.
+ */
+AVX2 void prefix_sum_int64_avx2(const int64_t* a, int64_t* r, uint32_t n) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i carry = zero;
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x90), zero, 0x03));
+		x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x40), zero, 0x0f));
+		x = _mm256_add_epi64(x, carry);
+		_mm256_storeu_si256((__m256i*)(r + i), x);
+		carry = _mm256_permute4x64_epi64(x, 0xff);
+	}
+	uint64_t sum = i > 0 ? r[i - 1] : 0;
+	for (; i < n; i++) {
+		sum += a[i];
+		r[i] = sum;
+	}
+}
+
+AVX2 void add_double_avx2(const double* a, const double* b, double* r, uint32_t n) {
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(r + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+	}
+	add_double(a + i, b + i, r + i, n - i);
+}
+
+AVX2 void sub_double_avx2(const double* a, const double* b, double* r, uint32_t n) {
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(r + i, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+	}
+	sub_double(a + i, b + i, r + i, n - i);
+}
+
+AVX2 void mul_double_avx2(const double* a, const double* b, double* r, uint32_t n) {
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(r + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+	}
+	mul_double(a + i, b + i, r + i, n - i);
+}
+
+AVX2 double dot_double_avx2(const double* a, const double* b, uint32_t n) {
+	__m256d sum0 = _mm256_setzero_pd();
+	__m256d sum1 = _mm256_setzero_pd();
+	uint32_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+		sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+	}
+	return hsum_pd(_mm256_add_pd(sum0, sum1)) + dot_double(a + i, b + i, n - i);
+}
+
+AVX2 double sum_double_avx2(const double* a, uint32_t n) {
+	__m256d sum0 = _mm256_setzero_pd();
+	__m256d sum1 = _mm256_setzero_pd();
+	uint32_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(a + i));
+		sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(a + i + 4));
+	}
+	return hsum_pd(_mm256_add_pd(sum0, sum1)) + sum_double(a + i, n - i);
+}
+
+AVX2 double min_double_avx2(const double* a, uint32_t n) {
+	if (n < 4) {
+		return min_double(a, n);
+	}
+	__m256d m = _mm256_loadu_pd(a);
+	uint32_t i = 4;
+	for (; i + 4 <= n; i += 4) {
+		m = _mm256_min_pd(_mm256_loadu_pd(a + i), m);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, m);
+	double result = min_double(lanes, 4);
+	return i < n ? min_double((double[]){ result, min_double(a + i, n - i) }, 2) : result;
+}
+
+AVX2 double max_double_avx2(const double* a, uint32_t n) {
+	if (n < 4) {
+		return max_double(a, n);
+	}
+	__m256d m = _mm256_loadu_pd(a);
+	uint32_t i = 4;
+	for (; i + 4 <= n; i += 4) {
+		m = _mm256_max_pd(_mm256_loadu_pd(a + i), m);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, m);
+	double result = max_double(lanes, 4);
+	return i < n ? max_double((double[]){ result, max_double(a + i, n - i) }, 2) : result;
+}
+
+AVX2 void prefix_sum_double_avx2(const double* a, double* r, uint32_t n) {
+	__m256d zero = _mm256_setzero_pd();
+	__m256d carry = zero;
+	uint32_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(a + i);
+		x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, 0x90), zero, 0x1));
+		x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, 0x40), zero, 0x3));
+		x = _mm256_add_pd(x, carry);
+		_mm256_storeu_pd(r + i, x);
+		carry = _mm256_permute4x64_pd(x, 0xff);
+	}
+	double sum = i > 0 ? r[i - 1] : 0;
+	for (; i < n; i++) {
+		sum += a[i];
+		r[i] = sum;
+	}
+}
+
+static const array_kernels avx2_kernels = {
+	add_int64_avx2,
+	sub_int64_avx2,
+	mul_int64_avx2,
+	dot_int64_avx2,
+	sum_int64_avx2,
+	min_int64_avx2,
+	max_int64_avx2,
+	prefix_sum_int64_avx2,
+	add_double_avx2,
+	sub_double_avx2,
+	mul_double_avx2,
+	dot_double_avx2,
+	sum_double_avx2,
+	min_double_avx2,
+	max_double_avx2,
+	prefix_sum_double_avx2
+};
+
+#endif
+
+static const array_kernels* _Atomic selected_kernels;
+
+const array_kernels* kernels() {
+	const array_kernels* k = atomic_load_explicit(&selected_kernels, memory_order_relaxed);
+	if (k == NULL) {
+		k = &portable_kernels;
+#ifdef OVS_ARRAY_AVX2
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			k = &avx2_kernels;
+		}
+#endif
+		atomic_store_explicit(&selected_kernels, k, memory_order_relaxed);
+	}
+	return k;
+}
+
+/*
+ * Array operations
+ */
+
+bool same_shape(ovs_expr a, ovs_expr b) {
+	return a.type == OVS_ARRAY
+		&& b.type == OVS_ARRAY
+		&& a.p->array.kind == b.p->array.kind
+		&& a.p->array.size == b.p->array.size;
+}
+
+ovs_expr elementwise(ovs_expr a, ovs_expr b,
+		void (*int64_kernel)(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n),
+		void (*double_kernel)(const double* a, const double* b, double* r, uint32_t n)) {
+	const ovs_array_data* x = &a.p->array;
+	const ovs_array_data* y = &b.p->array;
+	void* elements;
+	ovs_expr r = ovs_array(x->kind, x->size, &elements);
+	if (x->kind == OVS_INT64_ARRAY) {
+		int64_kernel(x->int64s, y->int64s, elements, x->size);
+	} else {
+		double_kernel(x->doubles, y->doubles, elements, x->size);
+	}
+	return r;
+}
+
+bool ovs_array_add(ovs_expr a, ovs_expr b, ovs_expr* r) {
+	if (!same_shape(a, b)) {
+		return false;
+	}
+	*r = elementwise(a, b, kernels()->add_int64, kernels()->add_double);
+	return true;
+}
+
+bool ovs_array_sub(ovs_expr a, ovs_expr b, ovs_expr* r) {
+	if (!same_shape(a, b)) {
+		return false;
+	}
+	*r = elementwise(a, b, kernels()->sub_int64, kernels()->sub_double);
+	return true;
+}
+
+bool ovs_array_mul(ovs_expr a, ovs_expr b, ovs_expr* r) {
+	if (!same_shape(a, b)) {
+		return false;
+	}
+	*r = elementwise(a, b, kernels()->mul_int64, kernels()->mul_double);
+	return true;
+}
+
+bool ovs_array_dot(ovs_expr a, ovs_expr b, ovs_expr* r) {
+	if (!same_shape(a, b)) {
+		return false;
+	}
+	const ovs_array_data* x = &a.p->array;
+	const ovs_array_data* y = &b.p->array;
+	if (x->kind == OVS_INT64_ARRAY) {
+		*r = ovs_integer(kernels()->dot_int64(x->int64s, y->int64s, x->size));
+	} else {
+		*r = ovs_float(kernels()->dot_double(x->doubles, y->doubles, x->size));
+	}
+	return true;
+}
+
+bool ovs_array_sum(ovs_expr a, ovs_expr* r) {
+	if (a.type != OVS_ARRAY) {
+		return false;
+	}
+	const ovs_array_data* x = &a.p->array;
+	if (x->kind == OVS_INT64_ARRAY) {
+		*r = ovs_integer(kernels()->sum_int64(x->int64s, x->size));
+	} else {
+		*r = ovs_float(kernels()->sum_double(x->doubles, x->size));
+	}
+	return true;
+}
+
+bool ovs_array_min(ovs_expr a, ovs_expr* r) {
+	if (a.type != OVS_ARRAY || a.p->array.size == 0) {
+		return false;
+	}
+	const ovs_array_data* x = &a.p->array;
+	if (x->kind == OVS_INT64_ARRAY) {
+		*r = ovs_integer(kernels()->min_int64(x->int64s, x->size));
+	} else {
+		*r = ovs_float(kernels()->min_double(x->doubles, x->size));
+	}
+	return true;
+}
+
+bool ovs_array_max(ovs_expr a, ovs_expr* r) {
+	if (a.type != OVS_ARRAY || a.p->array.size == 0) {
+		return false;
+	}
+	const ovs_array_data* x = &a.p->array;
+	if (x->kind == OVS_INT64_ARRAY) {
+		*r = ovs_integer(kernels()->max_int64(x->int64s, x->size));
+	} else {
+		*r = ovs_float(kernels()->max_double(x->doubles, x->size));
+	}
+	return true;
+}
+
+bool ovs_array_prefix_sum(ovs_expr a, ovs_expr* r) {
+	if (a.type != OVS_ARRAY) {
+		return false;
+	}
+	const ovs_array_data* x = &a.p->array;
+	void* elements;
+	*r = ovs_array(x->kind, x->size, &elements);
+	if (x->kind == OVS_INT64_ARRAY) {
+		kernels()->prefix_sum_int64(x->int64s, elements, x->size);
+	} else {
+		kernels()->prefix_sum_double(x->doubles, elements, x->size);
+	}
+	return true;
+}
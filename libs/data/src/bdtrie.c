@@ -293,7 +293,7 @@ bdtrie_node* add_child(bdtrie* t, bdtrie_node** np, uint8_t index, key k) {
 
 	if (replacement->has_leaf) {
 		bdtrie_leaf* leaf = leaf_of(replacement);
-		t->update_value(leaf, replacement);
+		t->update_value(leaf->value, replacement);
 	}
 
 	replacement->branch_size++;
@@ -0,0 +1,542 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uchar.h>
+#include <unicode/utf.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+#include <unicode/ustdio.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/io/stream.h"
+#include "c-ohvu/io/scanner.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+#include "c-ohvu/data/reader.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef ovs_expr expr;
+
+/*
+ * Stage one
+ *
+ * The input is indexed a window at a time. Each window is validated as
+ * UTF-8 and then classified sixty-four bytes at a time into bitmaps, from
+ * which the positions of structural bytes are extracted. A structural
+ * byte is a bracket, a qualifier, a double quote or a newline, or any
+ * byte at which a run of whitespace starts or ends.
+ *
+ * Those positions are all stage two needs to find the end of a name, a
+ * string, a comment or a run of whitespace. Everything else, such as
+ * whether a double quote opens a string or belongs to a name, depends on
+ * what comes before it and is left to stage two.
+ *
+ * The reader stops at the first ill-formed sequence as it would at the
+ * end of input, so indexing stops there too.
+ */
+
+#define INDEX_WINDOW_SIZE 65536
+
+typedef struct structural_index {
+	const uint8_t* bytes;
+	int64_t size;
+	int64_t indexed;
+	int64_t base;
+	uint64_t carry;
+	int32_t count;
+	int32_t next;
+	uint32_t entries[INDEX_WINDOW_SIZE];
+} structural_index;
+
+int64_t find_malformed(const uint8_t* s, int64_t i, int64_t end) {
+	while (i < end) {
+#ifdef __SSE2__
+		while (end - i >= 16 && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i))) == 0) {
+			i += 16;
+		}
+		if (i == end) {
+			break;
+		}
+#endif
+		if (s[i] < 0x80) {
+			i++;
+			continue;
+		}
+		int32_t k = 0;
+		int32_t n = end - i < 4 ? end - i : 4;
+		UChar32 c;
+		U8_NEXT(s + i, k, n, c);
+		if (c < 0) {
+			return i;
+		}
+		i += k;
+	}
+	return end;
+}
+
+bool is_index_whitespace(uint8_t b) {
+	return b == ' ' || b == '\t' || b == '\n';
+}
+
+bool is_index_structural(uint8_t b) {
+	return b == '(' || b == ')' || b == '/' || b == '"' || b == '\n';
+}
+
+#ifdef __SSE2__
+
+void classify_chunk(const uint8_t* s, uint64_t* whitespace, uint64_t* structural) {
+	*whitespace = 0;
+	*structural = 0;
+	for (int k = 0; k < 4; k++) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + 16 * k));
+		__m128i newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+		__m128i w = _mm_or_si128(newline, _mm_or_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))));
+		__m128i t = _mm_or_si128(
+				_mm_or_si128(newline, _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))),
+				_mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('(')), _mm_cmpeq_epi8(v, _mm_set1_epi8(')'))),
+					_mm_cmpeq_epi8(v, _mm_set1_epi8('/'))));
+		*whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(w) << (16 * k);
+		*structural |= (uint64_t)(uint16_t)_mm_movemask_epi8(t) << (16 * k);
+	}
+}
+
+#else
+
+void classify_chunk(const uint8_t* s, uint64_t* whitespace, uint64_t* structural) {
+	*whitespace = 0;
+	*structural = 0;
+	for (int i = 0; i < 64; i++) {
+		*whitespace |= (uint64_t)is_index_whitespace(s[i]) << i;
+		*structural |= (uint64_t)is_index_structural(s[i]) << i;
+	}
+}
+
+#endif
+
+void index_chunk(structural_index* ix, const uint8_t* s, int64_t offset, int32_t n) {
+	uint64_t whitespace;
+	uint64_t structural;
+	classify_chunk(s, &whitespace, &structural);
+
+	uint64_t boundaries = whitespace ^ (whitespace << 1 | ix->carry);
+	ix->carry = whitespace >> (n - 1) & 1;
+
+	uint64_t entries = structural | boundaries;
+	if (n < 64) {
+		entries &= ((uint64_t)1 << n) - 1;
+	}
+	while (entries != 0) {
+		ix->entries[ix->count++] = offset + __builtin_ctzll(entries);
+		entries &= entries - 1;
+	}
+}
+
+/*
+ * A window ends before any multibyte sequence it would otherwise split.
+ * Four trailing bytes in a row cannot all belong to one sequence, so
+ * where backing off three bytes is not enough the last is a stray and
+ * the window may end before it.
+ */
+void index_window(structural_index* ix) {
+	int64_t start = ix->indexed;
+	int64_t end = ix->size;
+	if (end - start > INDEX_WINDOW_SIZE) {
+		end = start + INDEX_WINDOW_SIZE;
+		int64_t limit = end;
+		for (int i = 0; i < 3 && U8_IS_TRAIL(ix->bytes[end]); i++) {
+			end--;
+		}
+		if (U8_IS_TRAIL(ix->bytes[end])) {
+			end = limit;
+		}
+	}
+
+	int64_t malformed = find_malformed(ix->bytes, start, end);
+	if (malformed < end) {
+		end = malformed;
+		ix->size = malformed;
+	}
+
+	ix->base = start;
+	ix->count = 0;
+	ix->next = 0;
+
+	int64_t i = start;
+	for (; end - i >= 64; i += 64) {
+		index_chunk(ix, ix->bytes + i, i - start, 64);
+	}
+	if (i < end) {
+		uint8_t tail[64] = { 0 };
+		memcpy(tail, ix->bytes + i, end - i);
+		index_chunk(ix, tail, i - start, end - i);
+	}
+
+	ix->indexed = end;
+}
+
+/*
+ * The position of the first structural byte at or after p, or the end
+ * of input. Positions asked for never go backwards, so entries before
+ * one are dropped once passed.
+ */
+int64_t next_structural(structural_index* ix, int64_t p) {
+	while (true) {
+		while (ix->next < ix->count) {
+			int64_t q = ix->base + ix->entries[ix->next];
+			if (q >= p) {
+				return q;
+			}
+			ix->next++;
+		}
+		if (ix->indexed >= ix->size) {
+			return ix->size;
+		}
+		index_window(ix);
+	}
+}
+
+/*
+ * Stage two
+ *
+ * Expressions are built from the index by walking from one structural
+ * position to the next, with an explicit stack of the lists and quotes
+ * being read. The grammar is that of ovda_read, including where it is
+ * irregular: a double quote or semicolon only opens a string or comment
+ * at the start of a token, and the tail after a dot skips whitespace
+ * only once it is known not to start with a quote.
+ */
+
+typedef enum index_frame_kind {
+	INDEX_LIST,
+	INDEX_DOTTED_LIST,
+	INDEX_QUOTE
+} index_frame_kind;
+
+typedef struct index_frame {
+	index_frame_kind kind;
+	int32_t first;
+} index_frame;
+
+typedef struct index_parser {
+	structural_index* index;
+	ovs_context* context;
+	ovs_table* table;
+
+	UChar* scratch;
+	int64_t scratch_capacity;
+
+	index_frame* frames;
+	int32_t frame_count;
+	int32_t frame_capacity;
+
+	expr* values;
+	int32_t value_count;
+	int32_t value_capacity;
+} index_parser;
+
+/*
+ * The byte at i, or -1 at the end of input. Stage two only moves forward,
+ * so indexing on to reach i loses no entries it still needs.
+ */
+int32_t index_byte(index_parser* p, int64_t i) {
+	structural_index* ix = p->index;
+	while (i >= ix->indexed && ix->indexed < ix->size) {
+		index_window(ix);
+	}
+	return i < ix->size ? ix->bytes[i] : -1;
+}
+
+bool is_index_name_byte(index_parser* p, int64_t i) {
+	int32_t b = index_byte(p, i);
+	return b >= 0 && !is_index_whitespace(b) && b != '(' && b != ')' && b != '/';
+}
+
+int64_t skip_indexed_whitespace(index_parser* p, int64_t i) {
+	structural_index* ix = p->index;
+	while (true) {
+		int32_t b = index_byte(p, i);
+		if (b >= 0 && is_index_whitespace(b)) {
+			do {
+				i = next_structural(ix, i + 1);
+			} while (i < ix->size && is_index_whitespace(ix->bytes[i]));
+		} else if (b == ';') {
+			do {
+				i = next_structural(ix, i + 1);
+			} while (i < ix->size && ix->bytes[i] != '\n');
+		} else {
+			return i;
+		}
+	}
+}
+
+/*
+ * Widen well-formed UTF-8 into the scratch buffer.
+ */
+int32_t widen_indexed(index_parser* p, int64_t from, int64_t to) {
+	if (to - from > p->scratch_capacity) {
+		p->scratch_capacity = to - from;
+		p->scratch = realloc(p->scratch, sizeof(UChar) * p->scratch_capacity);
+	}
+
+	const uint8_t* s = p->index->bytes;
+	int32_t j = 0;
+	int64_t i = from;
+	while (i < to) {
+		if (s[i] < 0x80) {
+			p->scratch[j++] = s[i++];
+			continue;
+		}
+		int32_t k = 0;
+		UChar32 c;
+		U8_NEXT_UNSAFE(s + i, k, c);
+		U16_APPEND_UNSAFE(p->scratch, j, c);
+		i += k;
+	}
+	return j;
+}
+
+void push_index_value(index_parser* p, expr e) {
+	if (p->value_count == p->value_capacity) {
+		p->value_capacity *= 2;
+		p->values = realloc(p->values, sizeof(expr) * p->value_capacity);
+	}
+	p->values[p->value_count++] = e;
+}
+
+void push_index_frame(index_parser* p, index_frame_kind kind) {
+	if (p->frame_count == p->frame_capacity) {
+		p->frame_capacity *= 2;
+		p->frames = realloc(p->frames, sizeof(index_frame) * p->frame_capacity);
+	}
+	p->frames[p->frame_count++] = (index_frame){ kind, p->value_count };
+}
+
+expr quote_indexed(index_parser* p, expr data) {
+	expr list[] = { ovs_root_symbol(OVS_DATA_QUOTE)->expr, data };
+	expr e = ovs_list(p->table, 2, list);
+	ovs_dealias(data);
+	return e;
+}
+
+/*
+ * A proper list is built as one contiguous list, where the table allows,
+ * rather than a cons per element. A dotted list is consed up onto its
+ * tail as the recursive reader does.
+ */
+expr close_indexed_list(index_parser* p, expr* tail) {
+	index_frame* f = &p->frames[--p->frame_count];
+	expr* elements = p->values + f->first;
+	int32_t count = p->value_count - f->first;
+
+	expr l;
+	if (tail == NULL) {
+		l = ovs_list(p->table, count, elements);
+	} else {
+		l = *tail;
+		for (int32_t i = count - 1; i >= 0; i--) {
+			expr cons = ovs_cons(p->table, elements[i], l);
+			ovs_dealias(l);
+			l = cons;
+		}
+	}
+
+	for (int32_t i = 0; i < count; i++) {
+		ovs_dealias(elements[i]);
+	}
+	p->value_count = f->first;
+	return l;
+}
+
+ovda_result read_indexed_string(index_parser* p, int64_t* at, expr* e) {
+	structural_index* ix = p->index;
+	int64_t i = *at + 1;
+	int64_t end = next_structural(ix, i);
+	while (end < ix->size && ix->bytes[end] != '"') {
+		end = next_structural(ix, end + 1);
+	}
+	if (end == ix->size) {
+		return OVDA_INVALID;
+	}
+
+	int32_t len = widen_indexed(p, i, end);
+	*e = quote_indexed(p, ovs_string(len, p->scratch));
+	*at = end + 1;
+	return OVDA_SUCCESS;
+}
+
+ovda_result read_indexed_atom(index_parser* p, int64_t* at, expr* e) {
+	structural_index* ix = p->index;
+	expr symbol = { OVS_SYMBOL, .p=NULL };
+	ovs_table* t = p->table;
+	int64_t i = *at;
+	bool qualified;
+
+	do {
+		if (!is_index_name_byte(p, i)) {
+			return symbol.p ? OVDA_INVALID : OVDA_UNEXPECTED_TYPE;
+		}
+		int64_t end = next_structural(ix, i + 1);
+		while (is_index_name_byte(p, end)) {
+			end = next_structural(ix, end + 1);
+		}
+		int32_t len = widen_indexed(p, i, end);
+
+		qualified = index_byte(p, end) == '/';
+		i = qualified ? end + 1 : end;
+
+		if (symbol.p == NULL && !qualified && ovs_parse_integer(len, p->scratch, e)) {
+			*at = i;
+			return OVDA_SUCCESS;
+		}
+
+		symbol = ovs_symbol(t, len, p->scratch);
+		t = ovs_table_for(p->context, symbol.p);
+	} while (qualified);
+
+	*e = symbol;
+	*at = i;
+	return OVDA_SUCCESS;
+}
+
+ovda_result parse_indexed(index_parser* p, expr* e) {
+	expr nil = ovs_root_symbol(OVS_DATA_NIL)->expr;
+	int64_t i = skip_indexed_whitespace(p, 0);
+	bool after_dot = false;
+
+	while (true) {
+		expr value;
+		int32_t b = index_byte(p, i);
+
+		if (b == '"') {
+			if (read_indexed_string(p, &i, &value) != OVDA_SUCCESS) {
+				return OVDA_INVALID;
+			}
+
+		} else if (b == '\'') {
+			push_index_frame(p, INDEX_QUOTE);
+			i = skip_indexed_whitespace(p, i + 1);
+			after_dot = false;
+			continue;
+
+		} else {
+			if (after_dot) {
+				i = skip_indexed_whitespace(p, i);
+				b = index_byte(p, i);
+			}
+
+			ovda_result res = read_indexed_atom(p, &i, &value);
+			if (res == OVDA_INVALID) {
+				return OVDA_INVALID;
+			}
+			if (res == OVDA_UNEXPECTED_TYPE) {
+				if (b != '(') {
+					return OVDA_INVALID;
+				}
+				i = skip_indexed_whitespace(p, i + 1);
+				if (index_byte(p, i) != ')') {
+					push_index_frame(p, INDEX_LIST);
+					after_dot = false;
+					continue;
+				}
+				i++;
+				value = ovs_alias(nil);
+			}
+		}
+
+		/*
+		 * A value is complete, so finish every frame it completes and
+		 * then find out what the innermost open list expects next.
+		 */
+		after_dot = false;
+		while (p->frame_count > 0) {
+			index_frame* f = &p->frames[p->frame_count - 1];
+
+			if (f->kind == INDEX_QUOTE) {
+				p->frame_count--;
+				value = quote_indexed(p, value);
+				continue;
+			}
+
+			if (f->kind == INDEX_DOTTED_LIST) {
+				i = skip_indexed_whitespace(p, i);
+				if (index_byte(p, i) != ')') {
+					ovs_dealias(value);
+					return OVDA_INVALID;
+				}
+				i++;
+				value = close_indexed_list(p, &value);
+				continue;
+			}
+
+			push_index_value(p, value);
+			i = skip_indexed_whitespace(p, i);
+			b = index_byte(p, i);
+			if (b == '.') {
+				i++;
+				f->kind = INDEX_DOTTED_LIST;
+				after_dot = true;
+				break;
+			}
+			if (b == ')') {
+				i++;
+				value = close_indexed_list(p, NULL);
+				continue;
+			}
+			break;
+		}
+
+		if (p->frame_count == 0) {
+			*e = value;
+			return OVDA_SUCCESS;
+		}
+	}
+}
+
+ovda_result ovda_read_indexed(ovs_context* c, const char* s, int64_t length, ovs_expr* e) {
+	structural_index* ix = malloc(sizeof(structural_index));
+	ix->bytes = (const uint8_t*)s;
+	ix->size = length;
+	ix->indexed = 0;
+	ix->base = 0;
+	ix->carry = 0;
+	ix->count = 0;
+	ix->next = 0;
+
+	index_parser p;
+	p.index = ix;
+	p.context = c;
+	p.table = &c->root_tables[OVS_UNQUALIFIED];
+	p.scratch_capacity = 256;
+	p.scratch = malloc(sizeof(UChar) * p.scratch_capacity);
+	p.frame_capacity = 64;
+	p.frame_count = 0;
+	p.frames = malloc(sizeof(index_frame) * p.frame_capacity);
+	p.value_capacity = 256;
+	p.value_count = 0;
+	p.values = malloc(sizeof(expr) * p.value_capacity);
+
+	ovda_result res = parse_indexed(&p, e);
+
+	for (int32_t i = 0; i < p.value_count; i++) {
+		ovs_dealias(p.values[i]);
+	}
+	free(p.values);
+	free(p.frames);
+	free(p.scratch);
+	free(ix);
+
+	return res;
+}
@@ -0,0 +1,585 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+/*
+ * Operand size in limbs below which multiplication is done directly
+ * rather than by Karatsuba's method.
+ */
+#define KARATSUBA_THRESHOLD 32
+
+/*
+ * The largest power of ten which fits a limb, and its exponent.
+ */
+#define DECIMAL_BASE 1000000000u
+#define DECIMAL_DIGITS 9
+
+/*
+ * A view of the sign and magnitude of either kind of integer. The limbs
+ * of a small integer are held in the view itself, so it must not be
+ * copied.
+ */
+typedef struct magnitude {
+	bool negative;
+	uint32_t size;
+	const uint32_t* limbs;
+	uint32_t small[2];
+} magnitude;
+
+void magnitude_of(const ovs_expr* e, magnitude* m) {
+	if (e->type == OVS_INTEGER) {
+		uint64_t v = e->integer < 0 ? 0 - (uint64_t)e->integer : (uint64_t)e->integer;
+		m->negative = e->integer < 0;
+		m->small[0] = (uint32_t)v;
+		m->small[1] = (uint32_t)(v >> 32);
+		m->size = m->small[1] != 0 ? 2 : m->small[0] != 0 ? 1 : 0;
+		m->limbs = m->small;
+	} else {
+		m->negative = e->p->big_integer.negative;
+		m->size = e->p->big_integer.size;
+		m->limbs = e->p->big_integer.limbs;
+	}
+}
+
+ovs_expr_ref* big_integer_ref(uint32_t capacity) {
+	size_t size = offsetof(ovs_expr_ref, big_integer)
+		+ offsetof(ovs_big_integer_data, limbs)
+		+ sizeof(uint32_t) * (capacity > 0 ? capacity : 1);
+	ovs_expr_ref* r = malloc(size);
+	r->ref_count = ATOMIC_VAR_INIT(1);
+	r->hash = ATOMIC_VAR_INIT(0);
+	return r;
+}
+
+/*
+ * Take ownership of a result computed in place in the limbs of r,
+ * trimming leading zero limbs and demoting it if it fits an int64_t.
+ */
+ovs_expr big_integer_result(ovs_expr_ref* r, uint32_t size, bool negative) {
+	const uint32_t* limbs = r->big_integer.limbs;
+	while (size > 0 && limbs[size - 1] == 0) {
+		size--;
+	}
+
+	if (size <= 2) {
+		uint64_t v = size == 0 ? 0 : limbs[0];
+		if (size == 2) {
+			v |= (uint64_t)limbs[1] << 32;
+		}
+		if (v <= INT64_MAX || (negative && v == (uint64_t)INT64_MAX + 1)) {
+			free(r);
+			return ovs_integer(negative ? (int64_t)(0 - v) : (int64_t)v);
+		}
+	}
+
+	r->big_integer.size = size;
+	r->big_integer.negative = negative;
+	return (ovs_expr){ OVS_BIG_INTEGER, .p=r };
+}
+
+/*
+ * Magnitude arithmetic
+ */
+
+int32_t compare_limbs(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn) {
+	if (an != bn) {
+		return an < bn ? -1 : 1;
+	}
+	for (uint32_t i = an; i-- > 0;) {
+		if (a[i] != b[i]) {
+			return a[i] < b[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * r = a + b, where an >= bn and r has room for an + 1 limbs.
+ */
+void add_limbs(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn, uint32_t* r) {
+	uint64_t carry = 0;
+	uint32_t i = 0;
+	for (; i < bn; i++) {
+		carry += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	for (; i < an; i++) {
+		carry += a[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	r[an] = (uint32_t)carry;
+}
+
+/*
+ * r = a - b, where a >= b and r has room for an limbs. r may be a.
+ */
+void sub_limbs(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn, uint32_t* r) {
+	uint64_t borrow = 0;
+	uint32_t i = 0;
+	for (; i < bn; i++) {
+		uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+		r[i] = (uint32_t)d;
+		borrow = d >> 63;
+	}
+	for (; i < an; i++) {
+		uint64_t d = (uint64_t)a[i] - borrow;
+		r[i] = (uint32_t)d;
+		borrow = d >> 63;
+	}
+}
+
+/*
+ * r += x in place, where the sum is known to fit in rn limbs.
+ */
+void add_into(uint32_t* r, uint32_t rn, const uint32_t* x, uint32_t xn) {
+	while (xn > 0 && x[xn - 1] == 0) {
+		xn--;
+	}
+	uint64_t carry = 0;
+	uint32_t i = 0;
+	for (; i < xn; i++) {
+		carry += (uint64_t)r[i] + x[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	for (; carry != 0 && i < rn; i++) {
+		carry += r[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+}
+
+/*
+ * r -= x in place, where x is known to be no greater than r.
+ */
+void sub_into(uint32_t* r, uint32_t rn, const uint32_t* x, uint32_t xn) {
+	while (xn > 0 && x[xn - 1] == 0) {
+		xn--;
+	}
+	sub_limbs(r, rn, x, xn, r);
+}
+
+/*
+ * limbs = limbs * m + a in place, returning the new size. There must be
+ * room for one more limb.
+ */
+uint32_t mul_add_small(uint32_t* limbs, uint32_t size, uint32_t m, uint32_t a) {
+	uint64_t carry = a;
+	for (uint32_t i = 0; i < size; i++) {
+		carry += (uint64_t)limbs[i] * m;
+		limbs[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	if (carry != 0) {
+		limbs[size++] = (uint32_t)carry;
+	}
+	return size;
+}
+
+/*
+ * q = a / d, returning the remainder. q may be a.
+ */
+uint32_t div_small(const uint32_t* a, uint32_t an, uint32_t d, uint32_t* q) {
+	uint64_t rem = 0;
+	for (uint32_t i = an; i-- > 0;) {
+		uint64_t n = rem << 32 | a[i];
+		q[i] = (uint32_t)(n / d);
+		rem = n % d;
+	}
+	return (uint32_t)rem;
+}
+
+void mul_schoolbook(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn, uint32_t* r) {
+	memset(r, 0, sizeof(uint32_t) * (an + bn));
+	for (uint32_t i = 0; i < bn; i++) {
+		uint64_t carry = 0;
+		for (uint32_t j = 0; j < an; j++) {
+			carry += (uint64_t)a[j] * b[i] + r[i + j];
+			r[i + j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		r[i + an] = (uint32_t)carry;
+	}
+}
+
+/*
+ * r = a * b, where r has room for an + bn limbs. Large operands are split
+ * in two at m limbs, so with a = a1 B + a0 and b = b1 B + b0,
+ *
+ *   a b = z2 B^2 + (z1 - z2 - z0) B + z0
+ *
+ * where z0 = a0 b0, z2 = a1 b1 and z1 = (a0 + a1)(b0 + b1), for three
+ * half size products rather than four.
+ */
+void mul_limbs(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn, uint32_t* r) {
+	if (an < bn) {
+		const uint32_t* t = a;
+		a = b;
+		b = t;
+		uint32_t tn = an;
+		an = bn;
+		bn = tn;
+	}
+
+	if (bn < KARATSUBA_THRESHOLD) {
+		mul_schoolbook(a, an, b, bn, r);
+		return;
+	}
+
+	if (2 * bn <= an) {
+		// too unbalanced to split evenly, so multiply b by pieces of a
+		memset(r, 0, sizeof(uint32_t) * (an + bn));
+		uint32_t* t = malloc(sizeof(uint32_t) * 2 * bn);
+		for (uint32_t i = 0; i < an; i += bn) {
+			uint32_t n = an - i < bn ? an - i : bn;
+			mul_limbs(a + i, n, b, bn, t);
+			add_into(r + i, an + bn - i, t, n + bn);
+		}
+		free(t);
+		return;
+	}
+
+	uint32_t m = an / 2;
+	const uint32_t* a1 = a + m;
+	const uint32_t* b1 = b + m;
+	uint32_t a1n = an - m;
+	uint32_t b1n = bn - m;
+
+	mul_limbs(a, m, b, m, r);
+	mul_limbs(a1, a1n, b1, b1n, r + 2 * m);
+
+	uint32_t san = a1n + 1;
+	uint32_t sbn = (b1n > m ? b1n : m) + 1;
+	uint32_t* sa = malloc(sizeof(uint32_t) * 2 * (san + sbn));
+	uint32_t* sb = sa + san;
+	uint32_t* z1 = sb + sbn;
+
+	add_limbs(a1, a1n, a, m, sa);
+	if (b1n > m) {
+		add_limbs(b1, b1n, b, m, sb);
+	} else {
+		add_limbs(b, m, b1, b1n, sb);
+	}
+	mul_limbs(sa, san, sb, sbn, z1);
+
+	sub_into(z1, san + sbn, r, 2 * m);
+	sub_into(z1, san + sbn, r + 2 * m, an + bn - 2 * m);
+	add_into(r + m, an + bn - m, z1, san + sbn);
+
+	free(sa);
+}
+
+/*
+ * q = a / b and r = a % b by Knuth's algorithm D, where bn >= 2, an >= bn,
+ * q has room for an - bn + 1 limbs and r for bn limbs.
+ */
+void div_limbs(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn, uint32_t* q, uint32_t* r) {
+	// normalize so the top bit of the divisor is set
+	int s = __builtin_clz(b[bn - 1]);
+	uint32_t* u = malloc(sizeof(uint32_t) * (an + 1 + bn));
+	uint32_t* v = u + an + 1;
+
+	for (uint32_t i = bn - 1; i > 0; i--) {
+		v[i] = b[i] << s | (uint32_t)((uint64_t)b[i - 1] >> (32 - s));
+	}
+	v[0] = b[0] << s;
+
+	u[an] = (uint32_t)((uint64_t)a[an - 1] >> (32 - s));
+	for (uint32_t i = an - 1; i > 0; i--) {
+		u[i] = a[i] << s | (uint32_t)((uint64_t)a[i - 1] >> (32 - s));
+	}
+	u[0] = a[0] << s;
+
+	for (uint32_t j = an - bn + 1; j-- > 0;) {
+		// estimate the quotient limb from the top two limbs
+		uint64_t n = (uint64_t)u[j + bn] << 32 | u[j + bn - 1];
+		uint64_t qhat = n / v[bn - 1];
+		uint64_t rhat = n % v[bn - 1];
+		while (qhat >> 32 != 0 || qhat * v[bn - 2] > (rhat << 32 | u[j + bn - 2])) {
+			qhat--;
+			rhat += v[bn - 1];
+			if (rhat >> 32 != 0) {
+				break;
+			}
+		}
+
+		// multiply and subtract
+		int64_t k = 0;
+		int64_t t;
+		for (uint32_t i = 0; i < bn; i++) {
+			uint64_t p = qhat * v[i];
+			t = (int64_t)u[i + j] - k - (int64_t)(p & 0xffffffffu);
+			u[i + j] = (uint32_t)t;
+			k = (int64_t)(p >> 32) - (t >> 32);
+		}
+		t = (int64_t)u[j + bn] - k;
+		u[j + bn] = (uint32_t)t;
+
+		// the estimate was one too large, so add back
+		q[j] = (uint32_t)qhat;
+		if (t < 0) {
+			q[j]--;
+			k = 0;
+			for (uint32_t i = 0; i < bn; i++) {
+				t = (int64_t)u[i + j] + v[i] + k;
+				u[i + j] = (uint32_t)t;
+				k = t >> 32;
+			}
+			u[j + bn] += (uint32_t)k;
+		}
+	}
+
+	for (uint32_t i = 0; i < bn - 1; i++) {
+		r[i] = u[i] >> s | (uint32_t)((uint64_t)u[i + 1] << (32 - s));
+	}
+	r[bn - 1] = u[bn - 1] >> s;
+
+	free(u);
+}
+
+/*
+ * Integers
+ */
+
+bool ovs_is_integer(ovs_expr e) {
+	return e.type == OVS_INTEGER || e.type == OVS_BIG_INTEGER;
+}
+
+ovs_expr add_magnitudes(const magnitude* a, const magnitude* b, bool b_negative) {
+	if (a->negative == b_negative) {
+		if (a->size < b->size) {
+			const magnitude* t = a;
+			a = b;
+			b = t;
+		}
+		ovs_expr_ref* r = big_integer_ref(a->size + 1);
+		add_limbs(a->limbs, a->size, b->limbs, b->size, r->big_integer.limbs);
+		return big_integer_result(r, a->size + 1, b_negative);
+	}
+
+	int32_t c = compare_limbs(a->limbs, a->size, b->limbs, b->size);
+	if (c == 0) {
+		return ovs_integer(0);
+	}
+	bool negative = c > 0 ? a->negative : b_negative;
+	if (c < 0) {
+		const magnitude* t = a;
+		a = b;
+		b = t;
+	}
+	ovs_expr_ref* r = big_integer_ref(a->size);
+	sub_limbs(a->limbs, a->size, b->limbs, b->size, r->big_integer.limbs);
+	return big_integer_result(r, a->size, negative);
+}
+
+ovs_expr ovs_integer_add(ovs_expr a, ovs_expr b) {
+	int64_t result;
+	if (a.type == OVS_INTEGER
+			&& b.type == OVS_INTEGER
+			&& !__builtin_add_overflow(a.integer, b.integer, &result)) {
+		return ovs_integer(result);
+	}
+
+	magnitude ma;
+	magnitude mb;
+	magnitude_of(&a, &ma);
+	magnitude_of(&b, &mb);
+	return add_magnitudes(&ma, &mb, mb.negative);
+}
+
+ovs_expr ovs_integer_sub(ovs_expr a, ovs_expr b) {
+	int64_t result;
+	if (a.type == OVS_INTEGER
+			&& b.type == OVS_INTEGER
+			&& !__builtin_sub_overflow(a.integer, b.integer, &result)) {
+		return ovs_integer(result);
+	}
+
+	magnitude ma;
+	magnitude mb;
+	magnitude_of(&a, &ma);
+	magnitude_of(&b, &mb);
+	return add_magnitudes(&ma, &mb, !mb.negative && mb.size > 0);
+}
+
+ovs_expr ovs_integer_mul(ovs_expr a, ovs_expr b) {
+	int64_t result;
+	if (a.type == OVS_INTEGER
+			&& b.type == OVS_INTEGER
+			&& !__builtin_mul_overflow(a.integer, b.integer, &result)) {
+		return ovs_integer(result);
+	}
+
+	magnitude ma;
+	magnitude mb;
+	magnitude_of(&a, &ma);
+	magnitude_of(&b, &mb);
+	if (ma.size == 0 || mb.size == 0) {
+		return ovs_integer(0);
+	}
+
+	ovs_expr_ref* r = big_integer_ref(ma.size + mb.size);
+	mul_limbs(ma.limbs, ma.size, mb.limbs, mb.size, r->big_integer.limbs);
+	return big_integer_result(r, ma.size + mb.size, ma.negative != mb.negative);
+}
+
+/*
+ * Division truncates toward zero, and the remainder takes the sign of the
+ * dividend, as in C. Fails only if the divisor is zero.
+ */
+bool ovs_integer_divmod(ovs_expr a, ovs_expr b, ovs_expr* q, ovs_expr* r) {
+	if (a.type == OVS_INTEGER
+			&& b.type == OVS_INTEGER
+			&& !(a.integer == INT64_MIN && b.integer == -1)) {
+		if (b.integer == 0) {
+			return false;
+		}
+		*q = ovs_integer(a.integer / b.integer);
+		*r = ovs_integer(a.integer % b.integer);
+		return true;
+	}
+
+	magnitude ma;
+	magnitude mb;
+	magnitude_of(&a, &ma);
+	magnitude_of(&b, &mb);
+	if (mb.size == 0) {
+		return false;
+	}
+
+	if (compare_limbs(ma.limbs, ma.size, mb.limbs, mb.size) < 0) {
+		*q = ovs_integer(0);
+		*r = ovs_alias(a);
+		return true;
+	}
+
+	uint32_t qn = ma.size - mb.size + 1;
+	ovs_expr_ref* qr = big_integer_ref(qn);
+	ovs_expr_ref* rr = big_integer_ref(mb.size);
+	if (mb.size == 1) {
+		rr->big_integer.limbs[0] = div_small(ma.limbs, ma.size, mb.limbs[0], qr->big_integer.limbs);
+	} else {
+		div_limbs(ma.limbs, ma.size, mb.limbs, mb.size, qr->big_integer.limbs, rr->big_integer.limbs);
+	}
+
+	*q = big_integer_result(qr, qn, ma.negative != mb.negative);
+	*r = big_integer_result(rr, mb.size, ma.negative);
+	return true;
+}
+
+int32_t ovs_integer_compare(ovs_expr a, ovs_expr b) {
+	if (a.type == OVS_INTEGER && b.type == OVS_INTEGER) {
+		return (a.integer > b.integer) - (a.integer < b.integer);
+	}
+
+	magnitude ma;
+	magnitude mb;
+	magnitude_of(&a, &ma);
+	magnitude_of(&b, &mb);
+	if (ma.negative != mb.negative) {
+		return ma.negative ? -1 : 1;
+	}
+	int32_t c = compare_limbs(ma.limbs, ma.size, mb.limbs, mb.size);
+	return ma.negative ? -c : c;
+}
+
+/*
+ * Parse a decimal integer with an optional leading minus sign, failing if
+ * the text is anything else.
+ */
+bool ovs_parse_integer(uint32_t length, const UChar* s, ovs_expr* e) {
+	bool negative = length > 1 && s[0] == u'-';
+	uint32_t start = negative ? 1 : 0;
+	if (start == length) {
+		return false;
+	}
+
+	bool fits = true;
+	int64_t v = 0;
+	for (uint32_t i = start; i < length; i++) {
+		if (s[i] < u'0' || s[i] > u'9') {
+			return false;
+		}
+		int64_t digit = s[i] - u'0';
+		fits = fits
+			&& !__builtin_mul_overflow(v, 10, &v)
+			&& !__builtin_add_overflow(v, negative ? -digit : digit, &v);
+	}
+	if (fits) {
+		*e = ovs_integer(v);
+		return true;
+	}
+
+	// a limb holds more than DECIMAL_DIGITS digits
+	ovs_expr_ref* r = big_integer_ref((length - start) / DECIMAL_DIGITS + 1);
+	uint32_t size = 0;
+	for (uint32_t i = start; i < length;) {
+		uint32_t chunk = 0;
+		uint32_t scale = 1;
+		for (uint32_t k = 0; k < DECIMAL_DIGITS && i < length; k++, i++) {
+			chunk = chunk * 10 + (s[i] - u'0');
+			scale *= 10;
+		}
+		size = mul_add_small(r->big_integer.limbs, size, scale, chunk);
+	}
+
+	*e = big_integer_result(r, size, negative);
+	return true;
+}
+
+/*
+ * The decimal representation of an integer, NUL terminated, which the
+ * caller must free.
+ */
+UChar* ovs_integer_text(ovs_expr e, uint32_t* length) {
+	magnitude m;
+	magnitude_of(&e, &m);
+
+	uint32_t* t = malloc(sizeof(uint32_t) * (m.size > 0 ? m.size : 1));
+	memcpy(t, m.limbs, sizeof(uint32_t) * m.size);
+
+	// a limb holds fewer than ten digits, plus room for sign and NUL
+	uint32_t capacity = m.size * 10 + 2;
+	UChar* s = malloc(sizeof(UChar) * capacity);
+	UChar* p = s + capacity;
+	*--p = 0;
+
+	uint32_t size = m.size;
+	do {
+		uint32_t chunk = div_small(t, size, DECIMAL_BASE, t);
+		while (size > 0 && t[size - 1] == 0) {
+			size--;
+		}
+		for (uint32_t k = 0; k < DECIMAL_DIGITS; k++) {
+			*--p = u'0' + chunk % 10;
+			chunk /= 10;
+			if (size == 0 && chunk == 0) {
+				break;
+			}
+		}
+	} while (size > 0);
+
+	if (m.negative) {
+		*--p = u'-';
+	}
+
+	free(t);
+
+	*length = s + capacity - 1 - p;
+	memmove(s, p, sizeof(UChar) * (*length + 1));
+	return s;
+}
@@ -0,0 +1,341 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+/*
+ * Bits of the hash consumed per level, and the shift of the last level,
+ * below which keys with identical hashes go into collision nodes.
+ */
+#define MAP_BITS 5
+#define MAP_MAX_SHIFT 30
+
+ovs_expr_ref* map_ref(uint32_t count, uint32_t entries, uint32_t nodes) {
+	size_t size = offsetof(ovs_expr_ref, map)
+		+ offsetof(ovs_map_data, slots)
+		+ sizeof(ovs_expr) * (2 * entries + nodes);
+	ovs_expr_ref* r = malloc(size);
+	r->ref_count = ATOMIC_VAR_INIT(1);
+	r->hash = ATOMIC_VAR_INIT(0);
+	r->map.count = count;
+	r->map.datamap = 0;
+	r->map.nodemap = 0;
+	r->map.entries = entries;
+	r->map.nodes = nodes;
+	return r;
+}
+
+ovs_expr map_node(const ovs_expr_ref* r) {
+	return (ovs_expr){ OVS_MAP, .p=r };
+}
+
+uint32_t map_bit(uint32_t hash, uint32_t shift) {
+	return 1u << ((hash >> shift) & 31);
+}
+
+uint32_t map_index(uint32_t bitmap, uint32_t bit) {
+	return __builtin_popcount(bitmap & (bit - 1));
+}
+
+void alias_slots(ovs_expr* to, const ovs_expr* from, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		to[i] = ovs_alias(from[i]);
+	}
+}
+
+/*
+ * A copy of r sharing all of its slots.
+ */
+ovs_expr_ref* copy_node(const ovs_expr_ref* r) {
+	const ovs_map_data* n = &r->map;
+	ovs_expr_ref* c = map_ref(n->count, n->entries, n->nodes);
+	c->map.datamap = n->datamap;
+	c->map.nodemap = n->nodemap;
+	alias_slots(c->map.slots, n->slots, 2 * n->entries + n->nodes);
+	return c;
+}
+
+void replace_slot(ovs_expr_ref* r, uint32_t i, ovs_expr e) {
+	ovs_dealias(r->map.slots[i]);
+	r->map.slots[i] = e;
+}
+
+/*
+ * A subnode holding two entries whose hashes agree below shift.
+ */
+ovs_expr_ref* merge_entries(uint32_t shift,
+		ovs_expr k1, ovs_expr v1, uint32_t h1,
+		ovs_expr k2, ovs_expr v2, uint32_t h2) {
+	if (shift > MAP_MAX_SHIFT) {
+		ovs_expr_ref* r = map_ref(2, 2, 0);
+		r->map.slots[0] = ovs_alias(k1);
+		r->map.slots[1] = ovs_alias(v1);
+		r->map.slots[2] = ovs_alias(k2);
+		r->map.slots[3] = ovs_alias(v2);
+		return r;
+	}
+
+	uint32_t b1 = map_bit(h1, shift);
+	uint32_t b2 = map_bit(h2, shift);
+	if (b1 == b2) {
+		ovs_expr_ref* r = map_ref(2, 0, 1);
+		r->map.nodemap = b1;
+		r->map.slots[0] = map_node(merge_entries(shift + MAP_BITS, k1, v1, h1, k2, v2, h2));
+		return r;
+	}
+
+	ovs_expr_ref* r = map_ref(2, 2, 0);
+	r->map.datamap = b1 | b2;
+	uint32_t first = b1 < b2 ? 0 : 2;
+	r->map.slots[first] = ovs_alias(k1);
+	r->map.slots[first + 1] = ovs_alias(v1);
+	r->map.slots[2 - first] = ovs_alias(k2);
+	r->map.slots[3 - first] = ovs_alias(v2);
+	return r;
+}
+
+ovs_expr_ref* insert_node(const ovs_expr_ref* r, uint32_t shift, uint32_t hash, ovs_expr key, ovs_expr value, bool* added) {
+	const ovs_map_data* n = &r->map;
+
+	if (shift > MAP_MAX_SHIFT) {
+		for (uint32_t i = 0; i < n->entries; i++) {
+			if (ovs_is_eq(n->slots[2 * i], key)) {
+				ovs_expr_ref* c = copy_node(r);
+				replace_slot(c, 2 * i + 1, ovs_alias(value));
+				*added = false;
+				return c;
+			}
+		}
+		ovs_expr_ref* c = map_ref(n->count + 1, n->entries + 1, 0);
+		alias_slots(c->map.slots, n->slots, 2 * n->entries);
+		c->map.slots[2 * n->entries] = ovs_alias(key);
+		c->map.slots[2 * n->entries + 1] = ovs_alias(value);
+		*added = true;
+		return c;
+	}
+
+	uint32_t bit = map_bit(hash, shift);
+
+	if (n->datamap & bit) {
+		uint32_t i = map_index(n->datamap, bit);
+		ovs_expr k = n->slots[2 * i];
+		ovs_expr v = n->slots[2 * i + 1];
+
+		if (ovs_is_eq(k, key)) {
+			ovs_expr_ref* c = copy_node(r);
+			replace_slot(c, 2 * i + 1, ovs_alias(value));
+			*added = false;
+			return c;
+		}
+
+		// move the existing entry down into a new subnode with the new one
+		ovs_expr_ref* child = merge_entries(shift + MAP_BITS, k, v, ovs_hash(k), key, value, hash);
+		ovs_expr_ref* c = map_ref(n->count + 1, n->entries - 1, n->nodes + 1);
+		c->map.datamap = n->datamap & ~bit;
+		c->map.nodemap = n->nodemap | bit;
+		uint32_t j = map_index(c->map.nodemap, bit);
+		ovs_expr* slots = c->map.slots;
+		const ovs_expr* nodes = n->slots + 2 * n->entries;
+		alias_slots(slots, n->slots, 2 * i);
+		alias_slots(slots + 2 * i, n->slots + 2 * i + 2, 2 * (n->entries - i - 1));
+		slots += 2 * (n->entries - 1);
+		alias_slots(slots, nodes, j);
+		slots[j] = map_node(child);
+		alias_slots(slots + j + 1, nodes + j, n->nodes - j);
+		*added = true;
+		return c;
+	}
+
+	if (n->nodemap & bit) {
+		uint32_t j = 2 * n->entries + map_index(n->nodemap, bit);
+		ovs_expr_ref* child = insert_node(n->slots[j].p, shift + MAP_BITS, hash, key, value, added);
+		ovs_expr_ref* c = copy_node(r);
+		replace_slot(c, j, map_node(child));
+		c->map.count += *added;
+		return c;
+	}
+
+	ovs_expr_ref* c = map_ref(n->count + 1, n->entries + 1, n->nodes);
+	c->map.datamap = n->datamap | bit;
+	c->map.nodemap = n->nodemap;
+	uint32_t i = map_index(c->map.datamap, bit);
+	alias_slots(c->map.slots, n->slots, 2 * i);
+	c->map.slots[2 * i] = ovs_alias(key);
+	c->map.slots[2 * i + 1] = ovs_alias(value);
+	alias_slots(c->map.slots + 2 * i + 2, n->slots + 2 * i, 2 * (n->entries - i) + n->nodes);
+	*added = true;
+	return c;
+}
+
+/*
+ * A copy of r without key, or NULL if it has no such key. A subnode left
+ * with a single entry is folded back into its parent.
+ */
+ovs_expr_ref* remove_node(const ovs_expr_ref* r, uint32_t shift, uint32_t hash, ovs_expr key) {
+	const ovs_map_data* n = &r->map;
+
+	if (shift > MAP_MAX_SHIFT) {
+		for (uint32_t i = 0; i < n->entries; i++) {
+			if (ovs_is_eq(n->slots[2 * i], key)) {
+				ovs_expr_ref* c = map_ref(n->count - 1, n->entries - 1, 0);
+				alias_slots(c->map.slots, n->slots, 2 * i);
+				alias_slots(c->map.slots + 2 * i, n->slots + 2 * i + 2, 2 * (n->entries - i - 1));
+				return c;
+			}
+		}
+		return NULL;
+	}
+
+	uint32_t bit = map_bit(hash, shift);
+
+	if (n->datamap & bit) {
+		uint32_t i = map_index(n->datamap, bit);
+		if (!ovs_is_eq(n->slots[2 * i], key)) {
+			return NULL;
+		}
+		ovs_expr_ref* c = map_ref(n->count - 1, n->entries - 1, n->nodes);
+		c->map.datamap = n->datamap & ~bit;
+		c->map.nodemap = n->nodemap;
+		alias_slots(c->map.slots, n->slots, 2 * i);
+		alias_slots(c->map.slots + 2 * i, n->slots + 2 * i + 2, 2 * (n->entries - i - 1) + n->nodes);
+		return c;
+	}
+
+	if (n->nodemap & bit) {
+		uint32_t j = map_index(n->nodemap, bit);
+		ovs_expr_ref* child = remove_node(n->slots[2 * n->entries + j].p, shift + MAP_BITS, hash, key);
+		if (child == NULL) {
+			return NULL;
+		}
+
+		if (child->map.count > 1) {
+			ovs_expr_ref* c = copy_node(r);
+			replace_slot(c, 2 * n->entries + j, map_node(child));
+			c->map.count--;
+			return c;
+		}
+
+		ovs_expr_ref* c = map_ref(n->count - 1, n->entries + 1, n->nodes - 1);
+		c->map.datamap = n->datamap | bit;
+		c->map.nodemap = n->nodemap & ~bit;
+		uint32_t i = map_index(c->map.datamap, bit);
+		const ovs_expr* nodes = n->slots + 2 * n->entries;
+		ovs_expr* slots = c->map.slots;
+		alias_slots(slots, n->slots, 2 * i);
+		slots[2 * i] = ovs_alias(child->map.slots[0]);
+		slots[2 * i + 1] = ovs_alias(child->map.slots[1]);
+		alias_slots(slots + 2 * i + 2, n->slots + 2 * i, 2 * (n->entries - i));
+		slots += 2 * (n->entries + 1);
+		alias_slots(slots, nodes, j);
+		alias_slots(slots + j, nodes + j + 1, n->nodes - j - 1);
+		ovs_dealias(map_node(child));
+		return c;
+	}
+
+	return NULL;
+}
+
+/*
+ * Maps
+ */
+
+ovs_expr ovs_map() {
+	return map_node(map_ref(0, 0, 0));
+}
+
+bool ovs_is_map(ovs_expr e) {
+	return e.type == OVS_MAP;
+}
+
+uint32_t ovs_map_count(ovs_expr m) {
+	return m.p->map.count;
+}
+
+bool ovs_map_lookup(ovs_expr m, ovs_expr key, ovs_expr* value) {
+	uint32_t hash = ovs_hash(key);
+	const ovs_map_data* n = &m.p->map;
+
+	for (uint32_t shift = 0; shift <= MAP_MAX_SHIFT; shift += MAP_BITS) {
+		uint32_t bit = map_bit(hash, shift);
+		if (n->datamap & bit) {
+			uint32_t i = map_index(n->datamap, bit);
+			if (!ovs_is_eq(n->slots[2 * i], key)) {
+				return false;
+			}
+			*value = ovs_alias(n->slots[2 * i + 1]);
+			return true;
+		}
+		if (!(n->nodemap & bit)) {
+			return false;
+		}
+		n = &n->slots[2 * n->entries + map_index(n->nodemap, bit)].p->map;
+	}
+
+	for (uint32_t i = 0; i < n->entries; i++) {
+		if (ovs_is_eq(n->slots[2 * i], key)) {
+			*value = ovs_alias(n->slots[2 * i + 1]);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Updates copy the path from the root to the changed entry and share
+ * every other node with the original map.
+ */
+ovs_expr ovs_map_insert(ovs_expr m, ovs_expr key, ovs_expr value) {
+	bool added;
+	return map_node(insert_node(m.p, 0, ovs_hash(key), key, value, &added));
+}
+
+ovs_expr ovs_map_remove(ovs_expr m, ovs_expr key) {
+	ovs_expr_ref* r = remove_node(m.p, 0, ovs_hash(key), key);
+	if (r == NULL) {
+		return ovs_alias(m);
+	}
+	return map_node(r);
+}
+
+/*
+ * Visit the entries of a map, in no particular order. The keys and
+ * values are borrowed from the map.
+ */
+void ovs_map_iterate(ovs_expr m, ovs_map_iterator* i) {
+	i->depth = 1;
+	i->nodes[0] = m.p;
+	i->positions[0] = 0;
+}
+
+bool ovs_map_next(ovs_map_iterator* i, ovs_expr* key, ovs_expr* value) {
+	while (i->depth > 0) {
+		const ovs_map_data* n = &i->nodes[i->depth - 1]->map;
+		uint32_t p = i->positions[i->depth - 1]++;
+
+		if (p < n->entries) {
+			*key = n->slots[2 * p];
+			*value = n->slots[2 * p + 1];
+			return true;
+		}
+
+		if (p < n->entries + n->nodes) {
+			i->nodes[i->depth] = n->slots[n->entries + p].p;
+			i->positions[i->depth] = 0;
+			i->depth++;
+		} else {
+			i->depth--;
+		}
+	}
+	return false;
+}
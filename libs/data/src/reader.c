@@ -3,8 +3,10 @@
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <uchar.h>
+#include <unicode/utf.h>
 #include <unicode/utypes.h>
 #include <unicode/uchar.h>
 #include <unicode/umachine.h>
@@ -22,6 +24,7 @@
 typedef ovio_scanner scanner;
 typedef ovio_strref strref;
 typedef ovda_reader reader;
+typedef ovda_cursor cursor;
 typedef ovda_cursor_stack cursor_stack;
 typedef ovs_expr expr;
 
@@ -29,51 +32,122 @@ reader* ovda_open_reader(scanner* s, ovs_context* c) {
 	reader* r = malloc(sizeof(reader));
 	r->scanner = s;
 	r->context = c;
-	r->cursor.position = 0;
-	r->cursor.stack = NULL;
+	r->cursor.capacity = 16;
+	r->cursor.depth = 0;
+	r->cursor.cursors = malloc(sizeof(cursor) * r->cursor.capacity);
+	r->cursor.cursors[0] = (cursor){ 0, 0, 0, false };
+	r->value_capacity = 64;
+	r->value_count = 0;
+	r->values = malloc(sizeof(expr) * r->value_capacity);
+	r->scratch = NULL;
+	r->scratch_capacity = 0;
+	r->step = OVDA_STEP_SKIP;
+	r->quotes = 0;
+	r->fed = NULL;
+
+	return r;
+}
+
+reader* ovda_open_push_reader(ovs_context* c) {
+	reader* r = ovda_open_reader(NULL, c);
+	r->fed = malloc(sizeof(ovda_fed_input));
+	r->fed->text = NULL;
+	r->fed->length = 0;
+	r->fed->capacity = 0;
+	r->fed->start = 0;
+	r->fed->read = 0;
+	r->fed->partial_length = 0;
+	r->fed->ended = false;
+	r->fed->run = NULL;
+	r->fed->scanned = 0;
 
 	return r;
 }
 
 void ovda_close_reader(reader* r) {
-	cursor_stack* s = r->cursor.stack;
-	while (s != NULL) {
-		cursor_stack* p = s;
-		s = p->stack;
-		free(p);
+	for (int32_t i = 0; i < r->value_count; i++) {
+		ovs_dealias(r->values[i]);
+	}
+	free(r->values);
+	free(r->cursor.cursors);
+	free(r->scratch);
+	if (r->fed != NULL) {
+		free(r->fed->text);
+		free(r->fed);
 	}
 	free(r);
 }
 
+/*
+ * Cursors
+ *
+ * The cursor at depth zero is for the top level, and there is one more for
+ * each list the reader is inside. The elements read so far of the lists
+ * still being built are kept on the value stack of the reader.
+ */
+
 int64_t ovda_cursor_position(reader* r, int32_t depth) {
-	cursor_stack s = r->cursor;
-	for (int32_t i = 0; i < depth; i++) {
-		s = *s.stack;
-	}
-	return s.position;
+	return r->cursor.cursors[r->cursor.depth - depth].position;
 }
 
 int32_t ovda_cursor_depth(reader* r) {
-	int32_t d = 0;
-	cursor_stack s = r->cursor;
-	while (s.stack != NULL) {
-		d++;
-		s = *s.stack;
+	return r->cursor.depth;
+}
+
+void push_cursor(reader* r, int32_t quotes) {
+	cursor_stack* s = &r->cursor;
+	if (s->depth + 1 == s->capacity) {
+		s->capacity *= 2;
+		s->cursors = realloc(s->cursors, sizeof(cursor) * s->capacity);
 	}
-	return d;
+	s->cursors[++s->depth] = (cursor){ 0, r->value_count, quotes, false };
 }
 
-int32_t push_cursor(reader* r) {
-	cursor_stack* s = malloc(sizeof(cursor_stack));
-	*s = r->cursor;
-	r->cursor.position = 0;
-	r->cursor.stack = s;
+void push_value(reader* r, expr e) {
+	if (r->value_count == r->value_capacity) {
+		r->value_capacity *= 2;
+		r->values = realloc(r->values, sizeof(expr) * r->value_capacity);
+	}
+	r->values[r->value_count++] = e;
+}
+
+expr quote(reader* r, expr data, int32_t quotes) {
+	for (int32_t i = 0; i < quotes; i++) {
+		expr list[] = { ovs_root_symbol(OVS_DATA_QUOTE)->expr, data };
+		expr e = ovs_list(&r->context->root_tables[OVS_UNQUALIFIED], 2, list);
+		ovs_dealias(data);
+		data = e;
+	}
+	return data;
 }
 
-int32_t pop_cursor(reader* r) {
-	cursor_stack* s = r->cursor.stack;
-	r->cursor = *s;
-	free(s);
+/*
+ * Pop the innermost cursor and build its list from the elements it read,
+ * ending in nil or, if it is dotted, in the last of them.
+ */
+expr close_list(reader* r) {
+	ovs_table* t = &r->context->root_tables[OVS_UNQUALIFIED];
+	cursor* c = &r->cursor.cursors[r->cursor.depth--];
+	expr* elements = r->values + c->first;
+	int32_t count = r->value_count - c->first;
+
+	expr l;
+	if (!c->dotted) {
+		l = count > 0 ? ovs_list(t, count, elements) : ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+	} else {
+		l = elements[--count];
+		for (int32_t i = count - 1; i >= 0; i--) {
+			expr cons = ovs_cons(t, elements[i], l);
+			ovs_dealias(l);
+			l = cons;
+		}
+	}
+
+	for (int32_t i = 0; i < count; i++) {
+		ovs_dealias(elements[i]);
+	}
+	r->value_count = c->first;
+	return quote(r, l, c->quotes);
 }
 
 /*
@@ -87,7 +161,11 @@ const UChar32 dot = U'.';
 const UChar32 double_quote = U'"';
 const UChar32 single_quote = U'\'';
 const UChar32 comment = U';';
-const UChar32 newline = U'\n';
+
+const ovio_class whitespace_class = { false, 3, " \t\n" };
+const ovio_class symbol_class = { true, 6, "/() \t\n" };
+const ovio_class string_class = { true, 1, "\"" };
+const ovio_class comment_class = { true, 1, "\n" };
 
 bool is_whitespace(UChar32 c, const void* v) {
 	return U' ' == c || U'\t' == c || U'\n' == c;
@@ -107,6 +185,41 @@ bool is_symbol_leading_character(UChar32 c, const void* v) {
 	return is_symbol_character(c, v);
 }
 
+/*
+ * What a token is, given by its first character. Every character outside
+ * ASCII can only begin a name, so only ASCII needs a table.
+ */
+typedef enum token {
+	TOKEN_NAME,
+	TOKEN_SPACE,
+	TOKEN_STRING,
+	TOKEN_QUOTE,
+	TOKEN_OPEN,
+	TOKEN_CLOSE,
+	TOKEN_QUALIFIER,
+	TOKEN_END
+} token;
+
+const uint8_t ascii_tokens[128] = {
+	[' '] = TOKEN_SPACE,
+	['\t'] = TOKEN_SPACE,
+	['\n'] = TOKEN_SPACE,
+	[';'] = TOKEN_SPACE,
+	['"'] = TOKEN_STRING,
+	['\''] = TOKEN_QUOTE,
+	['('] = TOKEN_OPEN,
+	[')'] = TOKEN_CLOSE,
+	['/'] = TOKEN_QUALIFIER
+};
+
+token next_token(scanner* s) {
+	UChar32 c = ovio_peek_input(s);
+	if (c < 0) {
+		return TOKEN_END;
+	}
+	return c < 0x80 ? ascii_tokens[c] : TOKEN_NAME;
+}
+
 bool is_equal(UChar32 c, const void* to) {
 	return c == *(UChar32*)to;
 }
@@ -119,69 +232,102 @@ bool is_not_equal(UChar32 c, const void* to) {
  * Read Operations
  */
 
-void skip_whitespace(scanner* s) {
-	ovio_advance_input_while(s, is_whitespace, NULL);
-	while (ovio_advance_input_if(s, is_equal, &comment)) {
-		ovio_advance_input_while(s, is_not_equal, &newline);
-		ovio_advance_input_while(s, is_whitespace, NULL);
+/*
+ * In push mode, note the class of a run which is the first thing to reach
+ * the end of the input fed so far. Until more input arrives which ends
+ * the run, taking the step again would only reach the end again.
+ */
+void advance_run(reader* r, const ovio_class* c) {
+	bool seen = r->fed != NULL && ovio_seen_end_of_input(r->scanner);
+	ovio_advance_input_while_class(r->scanner, c);
+	if (r->fed != NULL && !seen && ovio_seen_end_of_input(r->scanner)) {
+		r->fed->run = c;
 	}
-	ovio_discard_buffer(s);
 }
 
-int32_t scan_name(scanner* s) {
-	int32_t start = ovio_input_position(s);
-	if (ovio_advance_input_if(s, is_symbol_leading_character, NULL)) {
-		ovio_advance_input_while(s, is_symbol_character, NULL);
-		return ovio_input_position(s) - start;
+void skip_whitespace(reader* r) {
+	advance_run(r, &whitespace_class);
+	while (ovio_advance_input_if(r->scanner, is_equal, &comment)) {
+		advance_run(r, &comment_class);
+		advance_run(r, &whitespace_class);
 	}
-	return -1;
+	ovio_discard_buffer(r->scanner);
 }
 
-ovda_result ovda_read_list(reader* r, expr* e) {
-	if (ovda_read_step_in(r) == OVDA_SUCCESS) {
-		skip_whitespace(r->scanner);
+int32_t scan_name(reader* r) {
+	int32_t start = ovio_input_position(r->scanner);
+	if (ovio_advance_input_if(r->scanner, is_symbol_leading_character, NULL)) {
+		advance_run(r, &symbol_class);
+		return ovio_input_position(r->scanner) - start;
+	}
+	return -1;
+}
 
-		return ovda_read_step_out(r, e);
+/*
+ * The next len units of the buffer, borrowed from the scanner where it can
+ * lend them and otherwise copied into the scratch space of the reader.
+ * Either way they are only good until the buffer next moves.
+ */
+UChar* take_token(reader* r, int32_t len) {
+	if (len == 0) {
+		return (UChar*)u"";
 	}
-	return OVDA_SUCCESS;
+	const UChar* span = ovio_borrow_buffer_length(r->scanner, len);
+	if (span != NULL) {
+		return (UChar*)span;
+	}
+	if (len > r->scratch_capacity) {
+		r->scratch_capacity = len < 64 ? 64 : len;
+		free(r->scratch);
+		r->scratch = malloc(sizeof(UChar) * r->scratch_capacity);
+	}
+	ovio_take_buffer_length(r->scanner, len, r->scratch);
+	return r->scratch;
 }
 
-ovda_result ovda_read_symbol(reader* r, expr* e) {
-	skip_whitespace(r->scanner);
-       
+ovda_result read_name(reader* r, expr* e, bool literals) {
 	expr symbol = { OVS_SYMBOL, .p=NULL };
 	ovs_table* t = &r->context->root_tables[OVS_UNQUALIFIED];
+	bool qualified;
 
 	do {
 		ovio_discard_buffer(r->scanner);
-		int32_t len = scan_name(r->scanner);
+		int32_t len = scan_name(r);
 		if (len <= 0) {
 			if (symbol.p) {
 				return OVDA_INVALID;
 			}
 			return OVDA_UNEXPECTED_TYPE;
 		}
-		UChar* n = malloc(sizeof(UChar) * len);
-		ovio_take_buffer_length(r->scanner, len, n);
+		UChar* n = take_token(r, len);
+
+		qualified = ovio_advance_input_if(r->scanner, is_equal, &qualifier);
+
+		if (literals && symbol.p == NULL && !qualified && ovs_parse_integer(len, n, e)) {
+			return OVDA_SUCCESS;
+		}
 
 		symbol = ovs_symbol(t, len, n);
 		t = ovs_table_for(r->context, symbol.p);
-
-		free(n);
-	} while (ovio_advance_input_if(r->scanner, is_equal, &qualifier));
+	} while (qualified);
 
 	*e = symbol;
 
 	return OVDA_SUCCESS;
 }
 
-ovda_result read_string(reader* r, expr* e) {
-	if (!ovio_advance_input_if(r->scanner, is_equal, &double_quote)) {
-		return OVDA_UNEXPECTED_TYPE;
-	}
+ovda_result ovda_read_symbol(reader* r, expr* e) {
+	skip_whitespace(r);
+	return read_name(r, e, false);
+}
 
+/*
+ * The next character is known to be a double quote.
+ */
+ovda_result read_string(reader* r, expr* e) {
+	ovio_advance_input(r->scanner);
 	ovio_discard_buffer(r->scanner);
-	ovio_advance_input_while(r->scanner, is_not_equal, &double_quote);
+	advance_run(r, &string_class);
 
 	int32_t len = ovio_input_position(r->scanner) - ovio_buffer_position(r->scanner);
 
@@ -189,116 +335,370 @@ ovda_result read_string(reader* r, expr* e) {
 		return OVDA_INVALID;
 	}
 
-	UChar* c = malloc(sizeof(UChar) * len);
-	ovio_take_buffer_length(r->scanner, len, c);
-	expr string = ovs_string(len, c);
+	expr string = ovs_string(len, take_token(r, len));
 
 	expr list[] = { ovs_root_symbol(OVS_DATA_QUOTE)->expr, string };
 	*e = ovs_list(&r->context->root_tables[OVS_UNQUALIFIED], 2, list);
 
 	ovs_dealias(string);
-	free(c);
 
 	return OVDA_SUCCESS;
 }
 
-ovda_result read_quote(reader* r, expr* e) {
-	if (!ovio_advance_input_if(r->scanner, is_equal, &single_quote)) {
+/*
+ * Steps
+ *
+ * A read goes through a series of steps, each of which either completes a
+ * value or sets the step to take next. In push mode a step which looks
+ * past the input fed so far could have turned out differently with more,
+ * so it is taken again from the start once more is fed.
+ */
+
+bool certain(reader* r) {
+	return r->fed == NULL || r->fed->ended || !ovio_seen_end_of_input(r->scanner);
+}
+
+void commit_step(reader* r) {
+	if (r->fed != NULL) {
+		r->fed->read = r->fed->start + ovio_input_position(r->scanner);
+	}
+}
+
+/*
+ * Read a string, symbol or integer, or else count a quote or open a list
+ * to be finished by later steps. The token is told by its first
+ * character. Whitespace is already skipped, except after a dot, where a
+ * string or quote must follow immediately and past any whitespace a
+ * double or single quote begins a name instead.
+ */
+ovda_result read_value(reader* r, expr* e) {
+	token t = next_token(r->scanner);
+
+	if (t == TOKEN_QUOTE) {
+		ovio_advance_input(r->scanner);
+		r->quotes++;
+		r->step = OVDA_STEP_SKIP;
 		return OVDA_UNEXPECTED_TYPE;
 	}
 
-	ovio_discard_buffer(r->scanner);
+	if (t == TOKEN_SPACE) {
+		skip_whitespace(r);
+		t = next_token(r->scanner);
+		if (t == TOKEN_STRING || t == TOKEN_QUOTE) {
+			t = TOKEN_NAME;
+		}
+	}
+
+	if (t == TOKEN_OPEN) {
+		ovio_advance_input(r->scanner);
+		push_cursor(r, r->quotes);
+		r->quotes = 0;
+		r->step = OVDA_STEP_OPENED;
+		return OVDA_UNEXPECTED_TYPE;
+	}
 
-	expr data;
-	if (ovda_read(r, &data) != OVDA_SUCCESS) {
+	ovda_result res = OVDA_INVALID;
+	if (t == TOKEN_STRING) {
+		res = read_string(r, e);
+	} else if (t == TOKEN_NAME) {
+		res = read_name(r, e, true);
+	}
+
+	if (!certain(r)) {
+		if (res == OVDA_SUCCESS) {
+			ovs_dealias(*e);
+		}
+		return OVDA_NEED_INPUT;
+	}
+	if (res != OVDA_SUCCESS) {
 		return OVDA_INVALID;
 	}
+	*e = quote(r, *e, r->quotes);
+	r->quotes = 0;
+	return OVDA_SUCCESS;
+}
 
-	expr list[] = { ovs_root_symbol(OVS_DATA_QUOTE)->expr, data };
-	*e = ovs_list(&r->context->root_tables[OVS_UNQUALIFIED], 2, list);
+ovda_result read_step(reader* r, expr* e) {
+	if (r->step == OVDA_STEP_VALUE || r->step == OVDA_STEP_TAIL) {
+		return read_value(r, e);
+	}
+
+	skip_whitespace(r);
+	UChar32 next = ovio_peek_input(r->scanner);
+	if (!certain(r)) {
+		return OVDA_NEED_INPUT;
+	}
 
-	ovs_dealias(data);
+	if (r->step == OVDA_STEP_SKIP) {
+		r->step = OVDA_STEP_VALUE;
+		return OVDA_UNEXPECTED_TYPE;
+	}
 
-	return OVDA_SUCCESS;
+	if (next == close_bracket) {
+		ovio_advance_input(r->scanner);
+		*e = close_list(r);
+		return OVDA_SUCCESS;
+	}
+
+	if (r->step == OVDA_STEP_CLOSE) {
+		return OVDA_INVALID;
+	}
+
+	if (r->step == OVDA_STEP_NEXT && next == dot) {
+		ovio_advance_input(r->scanner);
+		r->cursor.cursors[r->cursor.depth].dotted = true;
+		r->step = OVDA_STEP_TAIL;
+		return OVDA_UNEXPECTED_TYPE;
+	}
+
+	r->step = OVDA_STEP_VALUE;
+	return OVDA_UNEXPECTED_TYPE;
 }
 
-ovda_result read_next(reader* r, expr* e) {
+/*
+ * Take steps until an expression is complete at the given depth. Lists
+ * are built iteratively, so neither their length nor their nesting is
+ * bounded by the C stack.
+ */
+ovda_result read_to_depth(reader* r, int32_t depth, expr* e) {
 	ovda_result res;
-	res = read_string(r, e);
+	while (true) {
+		expr value;
+		res = read_step(r, &value);
+		if (res == OVDA_UNEXPECTED_TYPE) {
+			commit_step(r);
+			continue;
+		}
+		if (res != OVDA_SUCCESS) {
+			break;
+		}
+		commit_step(r);
 
-	if (res == OVDA_UNEXPECTED_TYPE) {
-		res = read_quote(r, e);
+		if (r->cursor.depth == depth) {
+			r->cursor.cursors[depth].position++;
+			r->step = OVDA_STEP_SKIP;
+			*e = value;
+			return OVDA_SUCCESS;
+		}
 
-		if (res == OVDA_UNEXPECTED_TYPE) {
-			res = ovda_read_symbol(r, e);
+		cursor* c = &r->cursor.cursors[r->cursor.depth];
+		push_value(r, value);
+		if (c->dotted) {
+			r->step = OVDA_STEP_CLOSE;
+		} else {
+			c->position++;
+			r->step = OVDA_STEP_NEXT;
+		}
+	}
 
-			if (res == OVDA_UNEXPECTED_TYPE) {
-				res = ovda_read_list(r, e);
+	if (res == OVDA_NEED_INPUT) {
+		return res;
+	}
+
+	if (r->cursor.depth > depth) {
+		int32_t first = r->cursor.cursors[depth + 1].first;
+		for (int32_t i = first; i < r->value_count; i++) {
+			ovs_dealias(r->values[i]);
+		}
+		r->value_count = first;
+		r->cursor.depth = depth;
+	}
+	r->step = OVDA_STEP_SKIP;
+	r->quotes = 0;
+	return OVDA_INVALID;
+}
+
+/*
+ * Push mode
+ *
+ * Each read scans the fed input from the start of the step it stopped
+ * at, and when a step completes the input before it is done with. A step
+ * stopped in a run, such as a long string fed a block at a time, is not
+ * taken again until the run ends, so a token is scanned a bounded number
+ * of times however many blocks it spans.
+ */
+
+void reserve_fed(ovda_fed_input* in, int64_t n) {
+	if (in->read > 0) {
+		memmove(in->text, in->text + in->read, sizeof(UChar) * (in->length - in->read));
+		in->length -= in->read;
+		in->scanned -= in->read;
+		in->read = 0;
+	}
+	if (in->length + n > in->capacity) {
+		in->capacity = in->capacity < 256 ? 512 : 2 * in->capacity;
+		if (in->capacity < in->length + n) {
+			in->capacity = in->length + n;
+		}
+		in->text = realloc(in->text, sizeof(UChar) * in->capacity);
+	}
+}
+
+/*
+ * The length of the UTF-8 sequence a byte begins, or zero if it cannot
+ * begin one.
+ */
+int32_t utf8_sequence_size(uint8_t lead) {
+	return lead < 0x80 ? 1 : lead < 0xc2 ? 0 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : lead < 0xf5 ? 4 : 0;
+}
+
+/*
+ * Widen UTF-8 onto the end of the text and return how much of it was
+ * used, which is less than all of it when it ends part way through a
+ * sequence. Malformed input ends the input, as it does for a scanner.
+ */
+int64_t widen_fed(ovda_fed_input* in, const uint8_t* s, int64_t n) {
+	reserve_fed(in, n);
+	int64_t i = 0;
+	while (i < n) {
+		if (s[i] < 0x80) {
+			in->text[in->length++] = s[i++];
+			continue;
+		}
+		int64_t start = i;
+		UChar32 c;
+		U8_NEXT(s, i, n, c);
+		if (c < 0) {
+			if (start + utf8_sequence_size(s[start]) > n) {
+				return start;
 			}
+			in->ended = true;
+			return n;
 		}
+		U16_APPEND_UNSAFE(in->text, in->length, c);
 	}
-	return res;
+	return n;
 }
 
-ovda_result ovda_read(reader* r, expr* e) {
-	skip_whitespace(r->scanner);
-	ovda_result res = read_next(r, e);
-	if (res != OVDA_SUCCESS) {
-		res = OVDA_INVALID;
+void feed_utf8(ovda_fed_input* in, const uint8_t* s, int64_t n) {
+	int64_t i = 0;
+	if (in->partial_length > 0) {
+		int32_t size = utf8_sequence_size(in->partial[0]);
+		while (in->partial_length < size && i < n) {
+			in->partial[in->partial_length++] = s[i++];
+		}
+		if (in->partial_length < size) {
+			return;
+		}
+		widen_fed(in, in->partial, in->partial_length);
+		in->partial_length = 0;
+		if (in->ended) {
+			return;
+		}
+	}
+
+	int64_t used = widen_fed(in, s + i, n - i);
+	while (i + used < n) {
+		in->partial[in->partial_length++] = s[i + used++];
 	}
-	return res;
 }
 
-ovda_result ovda_read_step_in(reader* r) {
-	skip_whitespace(r->scanner);
-	if (!ovio_advance_input_if(r->scanner, is_equal, &open_bracket)) {
-		return OVDA_UNEXPECTED_TYPE;
+void feed_utf16(ovda_fed_input* in, const UChar* s, int64_t n) {
+	if (in->partial_length > 0) {
+		in->ended = true;
+		return;
 	}
-	push_cursor(r);
-	return OVDA_SUCCESS;
+	reserve_fed(in, n);
+	memcpy(in->text + in->length, s, sizeof(UChar) * n);
+	in->length += n;
 }
 
-ovda_result ovda_read_step_out(reader* r, expr* e) {
-	if (ovda_cursor_depth(r) <= 0) {
-		return OVDA_UNEXPECTED_TYPE;
+/*
+ * Whether any character fed since the last read falls outside the run it
+ * stopped in.
+ */
+bool run_ended(ovda_fed_input* in, int64_t length) {
+	int64_t i = in->scanned;
+	while (i < length) {
+		UChar32 c;
+		U16_NEXT(in->text, i, length, c);
+		if (!ovio_class_has(in->run, c)) {
+			return true;
+		}
 	}
+	return false;
+}
 
-	if (ovio_advance_input_if(r->scanner, is_equal, &close_bracket)) {
-		ovio_discard_buffer(r->scanner);
+/*
+ * A lead surrogate at the end of the text may yet be paired, so it is
+ * left out until the input ends.
+ */
+ovda_result read_fed(reader* r, expr* e) {
+	ovda_fed_input* in = r->fed;
+	int64_t length = in->length;
+	if (!in->ended && length > in->read && U16_IS_LEAD(in->text[length - 1])) {
+		length--;
+	}
 
-		*e = ovs_root_symbol(OVS_DATA_NIL)->expr;
-		return OVDA_SUCCESS;
+	if (in->run != NULL && !in->ended && !run_ended(in, length)) {
+		in->scanned = length;
+		return OVDA_NEED_INPUT;
 	}
+	in->run = NULL;
 
-	expr head;
-	expr tail;
-	if (read_next(r, &head) != OVDA_SUCCESS) {
-		return OVDA_INVALID;
+	in->start = in->read;
+	ovio_stream* s = ovio_open_nustring_stream(in->text + in->start, length - in->start);
+	r->scanner = ovio_open_scanner(s);
+
+	ovda_result res = read_to_depth(r, 0, e);
+	in->scanned = length;
+	if (res != OVDA_NEED_INPUT) {
+		in->run = NULL;
 	}
 
-	skip_whitespace(r->scanner);
-	if (ovio_advance_input_if(r->scanner, is_equal, &dot)) {
-		if (!read_next(r, &tail)) {
-			ovs_dealias(head);
-			return OVDA_INVALID;
-		}
+	ovio_close_scanner(r->scanner);
+	ovio_close_stream(s);
+	r->scanner = NULL;
+	return res;
+}
 
-		skip_whitespace(r->scanner);
-		if (!ovio_advance_input_if(r->scanner, is_equal, &close_bracket)) {
-			ovs_dealias(head);
-			return OVDA_INVALID;
+ovda_result ovda_feed(reader* r, const ovio_block* b, expr* e) {
+	ovda_fed_input* in = r->fed;
+	if (b == NULL) {
+		in->ended = true;
+	} else if (!in->ended) {
+		if (b->encoding == OVIO_UTF8) {
+			feed_utf8(in, b->utf8_start, b->utf8_end - b->utf8_start);
+		} else {
+			feed_utf16(in, b->start, b->end - b->start);
 		}
-		
-	} else if (ovda_read_step_out(r, &tail) != OVDA_SUCCESS) {
-		ovs_dealias(head);
-		return OVDA_INVALID;
 	}
+	return ovda_read(r, e);
+}
 
-	expr cons = ovs_cons(&r->context->root_tables[OVS_UNQUALIFIED], head, tail);
+/*
+ * Reading
+ */
 
-	ovs_dealias(head);
-	ovs_dealias(tail);
+ovda_result ovda_read(reader* r, expr* e) {
+	if (r->fed != NULL) {
+		return read_fed(r, e);
+	}
+	r->step = OVDA_STEP_SKIP;
+	r->quotes = 0;
+	return read_to_depth(r, r->cursor.depth, e);
+}
 
-	*e = cons;
+ovda_result ovda_read_step_in(reader* r) {
+	skip_whitespace(r);
+	if (!ovio_advance_input_if(r->scanner, is_equal, &open_bracket)) {
+		return OVDA_UNEXPECTED_TYPE;
+	}
+	push_cursor(r, 0);
 	return OVDA_SUCCESS;
 }
+
+/*
+ * Read the rest of the list the reader last stepped into, leaving out any
+ * elements already read from it.
+ */
+ovda_result ovda_read_step_out(reader* r, expr* e) {
+	int32_t depth = r->cursor.depth - 1;
+	if (depth < 0) {
+		return OVDA_UNEXPECTED_TYPE;
+	}
+	r->cursor.cursors[depth + 1].first = r->value_count;
+	r->step = OVDA_STEP_OPENED;
+	r->quotes = 0;
+	return read_to_depth(r, depth, e);
+}
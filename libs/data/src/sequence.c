@@ -0,0 +1,617 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#define SEQUENCE_BITS 5
+#define SEQUENCE_WIDTH 32
+
+/*
+ * A concatenation may leave up to SEQUENCE_EXTRAS more nodes along the
+ * seam than the fewest which could hold their contents, and leaves alone
+ * any node which is short of full by no more than SEQUENCE_INVARIANT.
+ */
+#define SEQUENCE_EXTRAS 2
+#define SEQUENCE_INVARIANT 1
+
+size_t node_size(uint32_t height, uint32_t capacity) {
+	return offsetof(ovs_expr_ref, sequence)
+		+ offsetof(ovs_sequence_data, slots)
+		+ sizeof(ovs_expr) * capacity
+		+ (height > 0 ? sizeof(uint32_t) * capacity : 0);
+}
+
+ovs_expr_ref* sequence_ref(uint32_t height, uint32_t count, uint32_t capacity) {
+	ovs_expr_ref* r = malloc(node_size(height, capacity));
+	r->ref_count = ATOMIC_VAR_INIT(1);
+	r->hash = ATOMIC_VAR_INIT(0);
+	r->sequence.size = 0;
+	r->sequence.height = height;
+	r->sequence.count = count;
+	r->sequence.capacity = capacity;
+	r->sequence.relaxed = false;
+	return r;
+}
+
+ovs_expr sequence_node(const ovs_expr_ref* r) {
+	return (ovs_expr){ OVS_SEQUENCE, .p=r };
+}
+
+uint32_t* sequence_sizes(const ovs_expr_ref* r) {
+	return (uint32_t*)(r->sequence.slots + r->sequence.capacity);
+}
+
+const ovs_expr_ref* subnode(const ovs_expr_ref* r, uint32_t i) {
+	return r->sequence.slots[i].p;
+}
+
+uint32_t capacity_for(uint32_t count) {
+	uint32_t capacity = 1;
+	while (capacity < count) {
+		capacity <<= 1;
+	}
+	return capacity;
+}
+
+void alias_elements(ovs_expr* to, const ovs_expr* from, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		to[i] = ovs_alias(from[i]);
+	}
+}
+
+/*
+ * Whether every subnode of a node at the given height but the last must
+ * hold exactly this many elements for the node to be balanced.
+ */
+bool is_full(uint32_t size, uint32_t height) {
+	return SEQUENCE_BITS * height < 32 && size == 1u << (SEQUENCE_BITS * height);
+}
+
+/*
+ * Recompute the size of a node, and the sizes of the subnodes of an inner
+ * node along with whether it is relaxed.
+ */
+void settle(ovs_expr_ref* r) {
+	ovs_sequence_data* n = &r->sequence;
+	if (n->height == 0) {
+		n->size = n->count;
+		return;
+	}
+
+	uint32_t* sizes = sequence_sizes(r);
+	uint32_t size = 0;
+	bool relaxed = false;
+	for (uint32_t i = 0; i < n->count; i++) {
+		uint32_t s = subnode(r, i)->sequence.size;
+		relaxed |= i + 1 < n->count && !is_full(s, n->height);
+		size += s;
+		sizes[i] = size;
+	}
+	n->size = size;
+	n->relaxed = relaxed;
+}
+
+/*
+ * The subnode of an inner node holding index i, updating i to be relative
+ * to that subnode. Every subnode holds at most a full complement of
+ * elements, so the radix digit of i is a lower bound on its position.
+ */
+uint32_t locate(const ovs_expr_ref* r, uint32_t* i) {
+	const ovs_sequence_data* n = &r->sequence;
+	const uint32_t* sizes = sequence_sizes(r);
+	uint32_t shift = SEQUENCE_BITS * n->height;
+	uint32_t j = shift < 32 ? *i >> shift : 0;
+	if (n->relaxed) {
+		while (sizes[j] <= *i) {
+			j++;
+		}
+	}
+	if (j > 0) {
+		*i -= sizes[j - 1];
+	}
+	return j;
+}
+
+/*
+ * Strip single subnode roots from a tree.
+ */
+const ovs_expr_ref* collapse(const ovs_expr_ref* r) {
+	while (r->sequence.height > 0 && r->sequence.count == 1) {
+		const ovs_expr_ref* child = ovs_ref(subnode(r, 0));
+		ovs_dealias(sequence_node(r));
+		r = child;
+	}
+	return r;
+}
+
+/*
+ * Transients
+ */
+
+ovs_expr_ref* grow(ovs_expr_ref* r, uint32_t capacity) {
+	uint32_t previous = r->sequence.capacity;
+	r = realloc(r, node_size(r->sequence.height, capacity));
+	r->sequence.capacity = capacity;
+	if (r->sequence.height > 0) {
+		memmove(r->sequence.slots + capacity, r->sequence.slots + previous,
+				sizeof(uint32_t) * r->sequence.count);
+	}
+	return r;
+}
+
+/*
+ * A node with room for extra more slots to stand in for r, of which the
+ * caller owns a reference. If that is the only reference, nothing else
+ * can observe r changing, so it is reused in place; otherwise the caller
+ * gets a copy and gives up its reference to r.
+ */
+ovs_expr_ref* mutable_node(const ovs_expr_ref* r, uint32_t extra) {
+	const ovs_sequence_data* n = &r->sequence;
+	uint32_t count = n->count + extra;
+
+	if (atomic_load(&r->ref_count) == 1) {
+		ovs_expr_ref* m = (ovs_expr_ref*)r;
+		atomic_store_explicit(&m->hash, 0, memory_order_relaxed);
+		if (count > n->capacity) {
+			m = grow(m, capacity_for(count));
+		}
+		return m;
+	}
+
+	ovs_expr_ref* c = sequence_ref(n->height, n->count, capacity_for(count));
+	c->sequence.size = n->size;
+	c->sequence.relaxed = n->relaxed;
+	alias_elements(c->sequence.slots, n->slots, n->count);
+	if (n->height > 0) {
+		memcpy(sequence_sizes(c), sequence_sizes(r), sizeof(uint32_t) * n->count);
+	}
+	ovs_dealias(sequence_node(r));
+	return c;
+}
+
+ovs_expr_ref* set_node(const ovs_expr_ref* r, uint32_t i, ovs_expr e) {
+	ovs_expr_ref* m = mutable_node(r, 0);
+	if (m->sequence.height == 0) {
+		ovs_dealias(m->sequence.slots[i]);
+		m->sequence.slots[i] = e;
+	} else {
+		uint32_t j = locate(m, &i);
+		m->sequence.slots[j].p = set_node(subnode(m, j), i, e);
+	}
+	return m;
+}
+
+/*
+ * Replace the element at index i of the sequence owned by the caller,
+ * changing nodes in place where the caller holds the only reference.
+ */
+void ovs_sequence_set(ovs_expr* s, uint32_t i, ovs_expr e) {
+	assert(i < ovs_sequence_length(*s));
+	s->p = set_node(s->p, i, ovs_alias(e));
+}
+
+bool has_room(const ovs_expr_ref* r) {
+	while (r->sequence.height > 0 && r->sequence.count == SEQUENCE_WIDTH) {
+		r = subnode(r, SEQUENCE_WIDTH - 1);
+	}
+	return r->sequence.count < SEQUENCE_WIDTH;
+}
+
+/*
+ * A chain of single subnode nodes down to a leaf holding e.
+ */
+ovs_expr_ref* path(uint32_t height, ovs_expr e) {
+	ovs_expr_ref* r = sequence_ref(0, 1, 1);
+	r->sequence.slots[0] = e;
+	settle(r);
+	for (uint32_t h = 1; h <= height; h++) {
+		ovs_expr_ref* parent = sequence_ref(h, 1, 1);
+		parent->sequence.slots[0] = sequence_node(r);
+		settle(parent);
+		r = parent;
+	}
+	return r;
+}
+
+ovs_expr_ref* push_node(const ovs_expr_ref* r, ovs_expr e) {
+	const ovs_sequence_data* n = &r->sequence;
+
+	if (n->height == 0) {
+		ovs_expr_ref* m = mutable_node(r, 1);
+		m->sequence.slots[m->sequence.count++] = e;
+		m->sequence.size++;
+		return m;
+	}
+
+	uint32_t last = n->count - 1;
+	if (has_room(subnode(r, last))) {
+		ovs_expr_ref* m = mutable_node(r, 0);
+		m->sequence.slots[last].p = push_node(subnode(m, last), e);
+		sequence_sizes(m)[last]++;
+		m->sequence.size++;
+		return m;
+	}
+
+	ovs_expr_ref* m = mutable_node(r, 1);
+	ovs_sequence_data* mn = &m->sequence;
+	mn->relaxed |= !is_full(subnode(m, last)->sequence.size, mn->height);
+	mn->slots[mn->count++] = sequence_node(path(mn->height - 1, e));
+	mn->size++;
+	sequence_sizes(m)[last + 1] = mn->size;
+	return m;
+}
+
+/*
+ * Append e to the sequence owned by the caller, changing nodes in place
+ * where the caller holds the only reference, so that building a sequence
+ * one element at a time copies nothing.
+ */
+void ovs_sequence_push(ovs_expr* s, ovs_expr e) {
+	if (has_room(s->p)) {
+		s->p = push_node(s->p, ovs_alias(e));
+		return;
+	}
+
+	uint32_t height = s->p->sequence.height;
+	ovs_expr_ref* root = sequence_ref(height + 1, 2, 2);
+	root->sequence.slots[0] = *s;
+	root->sequence.slots[1] = sequence_node(path(height, ovs_alias(e)));
+	settle(root);
+	s->p = root;
+}
+
+/*
+ * Concatenation
+ *
+ * Two trees are joined along the seam between the right edge of the first
+ * and the left edge of the second. At each level of the seam the nodes
+ * meeting there have their contents redistributed, so that a tree built
+ * by repeated concatenation stays within a few steps of balanced.
+ */
+
+/*
+ * Plan how the slots of n nodes are redistributed, by merging the first
+ * node which is well short of full into those following it until there
+ * are few enough nodes. Returns the new number of nodes, whose counts are
+ * written over the old.
+ */
+uint32_t plan(uint32_t n, uint32_t* counts) {
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		total += counts[i];
+	}
+	uint32_t optimal = (total - 1) / SEQUENCE_WIDTH + 1;
+
+	uint32_t i = 0;
+	while (n > optimal + SEQUENCE_EXTRAS) {
+		while (counts[i] > SEQUENCE_WIDTH - SEQUENCE_INVARIANT) {
+			i++;
+		}
+		uint32_t remaining = counts[i];
+		do {
+			uint32_t merged = remaining + counts[i + 1];
+			counts[i] = merged < SEQUENCE_WIDTH ? merged : SEQUENCE_WIDTH;
+			remaining = merged - counts[i];
+			i++;
+		} while (remaining > 0);
+		memmove(counts + i, counts + i + 1, sizeof(uint32_t) * (n - i - 1));
+		n--;
+		i--;
+	}
+	return n;
+}
+
+ovs_expr_ref* inner_node(uint32_t height, uint32_t count, const ovs_expr_ref** nodes) {
+	ovs_expr_ref* r = sequence_ref(height, count, count);
+	for (uint32_t i = 0; i < count; i++) {
+		r->sequence.slots[i] = sequence_node(nodes[i]);
+	}
+	settle(r);
+	return r;
+}
+
+/*
+ * Join the subnodes of a but its last, those of middle, and those of b
+ * but its first, all of the height below the given one, redistributing
+ * their slots according to plan. Returns a node of the height above,
+ * holding one or two nodes of the given height. Either a or b may be
+ * NULL, and the reference to middle is consumed.
+ */
+ovs_expr_ref* rebalance(const ovs_expr_ref* a, ovs_expr_ref* middle, const ovs_expr_ref* b, uint32_t height) {
+	const ovs_expr_ref* all[3 * SEQUENCE_WIDTH];
+	uint32_t n = 0;
+	if (a != NULL) {
+		for (uint32_t i = 0; i + 1 < a->sequence.count; i++) {
+			all[n++] = subnode(a, i);
+		}
+	}
+	for (uint32_t i = 0; i < middle->sequence.count; i++) {
+		all[n++] = subnode(middle, i);
+	}
+	if (b != NULL) {
+		for (uint32_t i = 1; i < b->sequence.count; i++) {
+			all[n++] = subnode(b, i);
+		}
+	}
+
+	uint32_t counts[3 * SEQUENCE_WIDTH];
+	for (uint32_t i = 0; i < n; i++) {
+		counts[i] = all[i]->sequence.count;
+	}
+	uint32_t planned = plan(n, counts);
+
+	const ovs_expr_ref* nodes[3 * SEQUENCE_WIDTH];
+	uint32_t source = 0;
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < planned; i++) {
+		if (offset == 0 && all[source]->sequence.count == counts[i]) {
+			// untouched by the plan, so shared rather than copied
+			nodes[i] = ovs_ref(all[source++]);
+			continue;
+		}
+
+		ovs_expr_ref* r = sequence_ref(height - 1, counts[i], counts[i]);
+		uint32_t filled = 0;
+		while (filled < counts[i]) {
+			uint32_t available = all[source]->sequence.count - offset;
+			uint32_t wanted = counts[i] - filled;
+			uint32_t taken = available < wanted ? available : wanted;
+			alias_elements(r->sequence.slots + filled, all[source]->sequence.slots + offset, taken);
+			filled += taken;
+			offset += taken;
+			if (offset == all[source]->sequence.count) {
+				source++;
+				offset = 0;
+			}
+		}
+		settle(r);
+		nodes[i] = r;
+	}
+	ovs_dealias(sequence_node(middle));
+
+	ovs_expr_ref* parent = sequence_ref(height + 1, planned > SEQUENCE_WIDTH ? 2 : 1, 2);
+	if (planned > SEQUENCE_WIDTH) {
+		parent->sequence.slots[0] = sequence_node(inner_node(height, SEQUENCE_WIDTH, nodes));
+		parent->sequence.slots[1] = sequence_node(inner_node(height, planned - SEQUENCE_WIDTH, nodes + SEQUENCE_WIDTH));
+	} else {
+		parent->sequence.slots[0] = sequence_node(inner_node(height, planned, nodes));
+	}
+	settle(parent);
+	return parent;
+}
+
+/*
+ * A node one above the taller of a and b, holding their concatenation in
+ * one or two subnodes.
+ */
+ovs_expr_ref* join(const ovs_expr_ref* a, const ovs_expr_ref* b) {
+	uint32_t ha = a->sequence.height;
+	uint32_t hb = b->sequence.height;
+
+	if (ha > hb) {
+		ovs_expr_ref* middle = join(subnode(a, a->sequence.count - 1), b);
+		return rebalance(a, middle, NULL, ha);
+	}
+	if (ha < hb) {
+		ovs_expr_ref* middle = join(a, subnode(b, 0));
+		return rebalance(NULL, middle, b, hb);
+	}
+	if (ha > 0) {
+		ovs_expr_ref* middle = join(subnode(a, a->sequence.count - 1), subnode(b, 0));
+		return rebalance(a, middle, b, ha);
+	}
+
+	uint32_t total = a->sequence.count + b->sequence.count;
+	if (total <= SEQUENCE_WIDTH) {
+		ovs_expr_ref* leaf = sequence_ref(0, total, total);
+		alias_elements(leaf->sequence.slots, a->sequence.slots, a->sequence.count);
+		alias_elements(leaf->sequence.slots + a->sequence.count, b->sequence.slots, b->sequence.count);
+		settle(leaf);
+		const ovs_expr_ref* leaves[] = { leaf };
+		return inner_node(1, 1, leaves);
+	}
+	const ovs_expr_ref* leaves[] = { ovs_ref(a), ovs_ref(b) };
+	return inner_node(1, 2, leaves);
+}
+
+ovs_expr ovs_sequence_concat(ovs_expr a, ovs_expr b) {
+	if (ovs_sequence_length(a) == 0) {
+		return ovs_alias(b);
+	}
+	if (ovs_sequence_length(b) == 0) {
+		return ovs_alias(a);
+	}
+	return sequence_node(collapse(join(a.p, b.p)));
+}
+
+/*
+ * Splitting
+ */
+
+/*
+ * The first n elements below r, for 0 < n.
+ */
+const ovs_expr_ref* take(const ovs_expr_ref* r, uint32_t n) {
+	const ovs_sequence_data* d = &r->sequence;
+	if (n == d->size) {
+		return ovs_ref(r);
+	}
+
+	if (d->height == 0) {
+		ovs_expr_ref* leaf = sequence_ref(0, n, n);
+		alias_elements(leaf->sequence.slots, d->slots, n);
+		settle(leaf);
+		return leaf;
+	}
+
+	uint32_t i = n - 1;
+	uint32_t j = locate(r, &i);
+	ovs_expr_ref* c = sequence_ref(d->height, j + 1, j + 1);
+	alias_elements(c->sequence.slots, d->slots, j);
+	c->sequence.slots[j] = sequence_node(take(subnode(r, j), i + 1));
+	settle(c);
+	return c;
+}
+
+/*
+ * All but the first n elements below r, for n < size.
+ */
+const ovs_expr_ref* drop(const ovs_expr_ref* r, uint32_t n) {
+	const ovs_sequence_data* d = &r->sequence;
+	if (n == 0) {
+		return ovs_ref(r);
+	}
+
+	if (d->height == 0) {
+		ovs_expr_ref* leaf = sequence_ref(0, d->count - n, d->count - n);
+		alias_elements(leaf->sequence.slots, d->slots + n, d->count - n);
+		settle(leaf);
+		return leaf;
+	}
+
+	uint32_t i = n;
+	uint32_t j = locate(r, &i);
+	ovs_expr_ref* c = sequence_ref(d->height, d->count - j, d->count - j);
+	c->sequence.slots[0] = sequence_node(drop(subnode(r, j), i));
+	alias_elements(c->sequence.slots + 1, d->slots + j + 1, d->count - j - 1);
+	settle(c);
+	return c;
+}
+
+/*
+ * The elements of a slice are shared with the original, which only has
+ * the nodes along the two cut edges copied.
+ */
+ovs_expr ovs_sequence_slice(ovs_expr s, uint32_t from, uint32_t to) {
+	assert(from <= to && to <= ovs_sequence_length(s));
+
+	if (from == to) {
+		return ovs_sequence(0, NULL);
+	}
+	const ovs_expr_ref* prefix = take(s.p, to);
+	const ovs_expr_ref* r = drop(prefix, from);
+	ovs_dealias(sequence_node(prefix));
+	return sequence_node(collapse(r));
+}
+
+/*
+ * Sequences
+ */
+
+/*
+ * A balanced tree built from the leaves up.
+ */
+ovs_expr ovs_sequence(uint32_t count, ovs_expr* e) {
+	if (count == 0) {
+		return sequence_node(sequence_ref(0, 0, 0));
+	}
+
+	uint32_t n = (count - 1) / SEQUENCE_WIDTH + 1;
+	const ovs_expr_ref** level = malloc(sizeof(ovs_expr_ref*) * n);
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t size = count - i * SEQUENCE_WIDTH;
+		if (size > SEQUENCE_WIDTH) {
+			size = SEQUENCE_WIDTH;
+		}
+		ovs_expr_ref* leaf = sequence_ref(0, size, size);
+		alias_elements(leaf->sequence.slots, e + i * SEQUENCE_WIDTH, size);
+		settle(leaf);
+		level[i] = leaf;
+	}
+
+	for (uint32_t height = 1; n > 1; height++) {
+		uint32_t parents = (n - 1) / SEQUENCE_WIDTH + 1;
+		for (uint32_t i = 0; i < parents; i++) {
+			uint32_t size = n - i * SEQUENCE_WIDTH;
+			if (size > SEQUENCE_WIDTH) {
+				size = SEQUENCE_WIDTH;
+			}
+			level[i] = inner_node(height, size, level + i * SEQUENCE_WIDTH);
+		}
+		n = parents;
+	}
+
+	ovs_expr s = sequence_node(level[0]);
+	free(level);
+	return s;
+}
+
+int32_t ovs_sequence_of_list(ovs_table* t, ovs_expr l, ovs_expr* s) {
+	ovs_expr* e;
+	int32_t count = ovs_delist(t, l, &e);
+	if (count < 0) {
+		return count;
+	}
+	*s = ovs_sequence(count, e);
+	for (int32_t i = 0; i < count; i++) {
+		ovs_dealias(e[i]);
+	}
+	if (count > 0) {
+		free(e);
+	}
+	return count;
+}
+
+bool ovs_is_sequence(ovs_expr e) {
+	return e.type == OVS_SEQUENCE;
+}
+
+uint32_t ovs_sequence_length(ovs_expr s) {
+	return s.p->sequence.size;
+}
+
+ovs_expr ovs_sequence_index(ovs_expr s, uint32_t i) {
+	assert(i < ovs_sequence_length(s));
+	const ovs_expr_ref* r = s.p;
+	while (r->sequence.height > 0) {
+		r = subnode(r, locate(r, &i));
+	}
+	return ovs_alias(r->sequence.slots[i]);
+}
+
+ovs_expr ovs_sequence_update(ovs_expr s, uint32_t i, ovs_expr e) {
+	ovs_expr u = ovs_alias(s);
+	ovs_sequence_set(&u, i, e);
+	return u;
+}
+
+/*
+ * Iteration walks one leaf at a time, descending from the root again
+ * only on reaching the end of each.
+ */
+void ovs_sequence_iterate(ovs_expr s, ovs_sequence_iterator* i) {
+	i->root = s.p;
+	i->leaf = NULL;
+	i->index = 0;
+	i->position = 0;
+}
+
+bool ovs_sequence_next(ovs_sequence_iterator* i, ovs_expr* e) {
+	if (i->index == i->root->sequence.size) {
+		return false;
+	}
+	if (i->leaf == NULL || i->position == i->leaf->sequence.count) {
+		const ovs_expr_ref* r = i->root;
+		uint32_t position = i->index;
+		while (r->sequence.height > 0) {
+			r = subnode(r, locate(r, &position));
+		}
+		i->leaf = r;
+		i->position = position;
+	}
+	*e = i->leaf->sequence.slots[i->position++];
+	i->index++;
+	return true;
+}
@@ -5,12 +5,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <uchar.h>
 #include <unicode/utypes.h>
 #include <unicode/uchar.h>
 #include <unicode/umachine.h>
 #include <unicode/ucnv.h>
+#include <unicode/ustring.h>
 
 #include "c-ohvu/io/stringref.h"
 #include "c-ohvu/data/bdtrie.h"
@@ -18,6 +24,12 @@
 
 typedef ovio_strref strref;
 
+/*
+ * Initial capacity of the explicit stacks used to traverse structure
+ * without recursion, before they spill onto the heap.
+ */
+#define WORK_STACK_SIZE 32
+
 ovs_expr_ref* ref(uint32_t payload_size, uint32_t refs) {
 	size_t size = offsetof(ovs_expr_ref, symbol) + payload_size;
 	ovs_expr_ref* r = malloc(size);
@@ -41,6 +53,70 @@ void* ovs_function_extra_data(const ovs_function_data* d) {
 	return (void*)(d + 1);
 }
 
+typedef enum representation_state {
+	UNREPRESENTED,
+	REPRESENTING,
+	REPRESENTED
+} representation_state;
+
+/*
+ * The functions whose representations the current thread is building,
+ * innermost first, so that a represent callback which comes back to one
+ * of them fails rather than waiting on itself forever.
+ */
+typedef struct representing_function {
+	const ovs_function_data* d;
+	const struct representing_function* outer;
+} representing_function;
+
+static _Thread_local const representing_function* representing;
+
+bool is_representing(const ovs_function_data* d) {
+	for (const representing_function* f = representing; f != NULL; f = f->outer) {
+		if (f->d == d) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Functions are immutable, so their representation is built once and
+ * kept, and structural questions about them are answered from it
+ * without allocating. The result is borrowed.
+ *
+ * A function may be shared between threads. The first to ask builds the
+ * representation and any others wait for it to be published, so only
+ * one is kept. Building it must not ask for the representation of the
+ * same function again, including by hashing or consing the partial
+ * result.
+ */
+ovs_expr ovs_function_representation(const ovs_function_data* d) {
+	ovs_function_data* m = (ovs_function_data*)d;
+	int32_t state = atomic_load_explicit(&m->represented, memory_order_acquire);
+	if (state == REPRESENTED) {
+		return d->representation;
+	}
+
+	state = UNREPRESENTED;
+	if (atomic_compare_exchange_strong_explicit(&m->represented, &state, REPRESENTING, memory_order_acquire, memory_order_acquire)) {
+		representing_function f = { d, representing };
+		representing = &f;
+		m->representation = d->type->represent(d);
+		representing = f.outer;
+
+		m->symbolic = ovs_is_symbol(m->representation);
+		m->table = ovs_table_of(d->context, m->representation);
+		atomic_store_explicit(&m->represented, REPRESENTED, memory_order_release);
+	} else {
+		assert(!is_representing(d));
+		while (atomic_load_explicit(&m->represented, memory_order_acquire) != REPRESENTED) {
+			sched_yield();
+		}
+	}
+	return d->representation;
+}
+
 static ovs_root_symbol_data root_symbols[] = {
 	{ -1, u"data", OVS_UNQUALIFIED, { ATOMIC_VAR_INIT(0), .symbol={ NULL, .offset=OVS_DATA } } },
 	{ -1, u"nil", OVS_DATA, { ATOMIC_VAR_INIT(0), .symbol={ NULL, .offset=OVS_DATA_NIL } } },
@@ -69,6 +145,7 @@ void* ovs_get_value(uint32_t key_size, const void* key_data, const void* value_d
 		r->symbol.table = malloc(sizeof(ovs_table));
 		r->symbol.table->qualifier = r;
 		r->symbol.table->trie = (bdtrie) { NULL, ovs_get_value, ovs_update_value, free };
+		r->symbol.table->conses = NULL;
 	} else {
 		r = (ovs_expr_ref*)value_data;
 	}
@@ -84,6 +161,7 @@ void ovs_free_value(void* d) {
 			ovs_dealias(ovs_qualifier(e));
 		}
 		assert(r->symbol.table->trie.root == NULL);
+		ovs_table_hash_cons(r->symbol.table, false);
 		free(r->symbol.table);
 		free(r);
 	}
@@ -122,6 +200,21 @@ ovs_table* ovs_table_for(ovs_context* c, const ovs_expr_ref* r) {
 	}
 }
 
+/*
+ * The qualifier of a cons, contiguous list or vector. Vectors are
+ * always unqualified.
+ */
+ovs_expr_ref* cell_qualifier(const ovs_expr e) {
+	switch (e.type) {
+		case OVS_CONS:
+			return e.p->cons.table->qualifier;
+		case OVS_LIST:
+			return e.p->list.table->qualifier;
+		default:
+			return NULL;
+	}
+}
+
 ovs_table* ovs_table_of(ovs_context* c, const ovs_expr e) {
 	switch (e.type) {
 		case OVS_SYMBOL:
@@ -132,8 +225,10 @@ ovs_table* ovs_table_of(ovs_context* c, const ovs_expr e) {
 			}
 
 		case OVS_CONS:
+		case OVS_LIST:
+		case OVS_VECTOR:
 			;
-			ovs_expr_ref* q = e.p->cons.table->qualifier;
+			ovs_expr_ref* q = cell_qualifier(e);
 			if (q == NULL) {
 				return &c->root_tables[OVS_UNQUALIFIED];
 			} else {
@@ -143,15 +238,14 @@ ovs_table* ovs_table_of(ovs_context* c, const ovs_expr e) {
 		case OVS_FUNCTION:
 			;
 			const ovs_function_data* f = &e.p->function;
-			ovs_expr r = f->type->represent(f);
-			ovs_table* t = ovs_table_of(c, r);
-			ovs_dealias(r);
-			return t;
+			ovs_function_representation(f);
+			return f->table;
 
 		case OVS_CHARACTER:
 			return c->root_tables + OVS_TEXT_CHARACTER;
 
 		case OVS_STRING:
+		case OVS_SHORT_STRING:
 			return c->root_tables + OVS_TEXT_STRING;
 
 		default:
@@ -176,10 +270,8 @@ bool ovs_is_atom(ovs_table* t, const ovs_expr e) {
 bool ovs_is_symbol(ovs_expr e) {
 	if (e.type == OVS_FUNCTION) {
 		const ovs_function_data* f = &e.p->function;
-		ovs_expr r = f->type->represent(f);
-		bool symbol = ovs_is_symbol(r);
-		ovs_dealias(r);
-		return symbol;
+		ovs_function_representation(f);
+		return f->symbolic;
 	}
 	return e.type == OVS_SYMBOL;
 }
@@ -194,15 +286,13 @@ bool ovs_is_qualified(ovs_expr e) {
 			}
 
 		case OVS_CONS:
-			return e.p->cons.table->qualifier != NULL;
+		case OVS_LIST:
+		case OVS_VECTOR:
+			return cell_qualifier(e) != NULL;
 
 		case OVS_FUNCTION:
 			;
-			const ovs_function_data* f = &e.p->function;
-			ovs_expr r = f->type->represent(f);
-			bool q = ovs_is_qualified(r);
-			ovs_dealias(r);
-			return q;
+			return ovs_is_qualified(ovs_function_representation(&e.p->function));
 
 		default:
 			return true;
@@ -219,20 +309,19 @@ ovs_expr ovs_qualifier(ovs_expr e) {
 			}
 
 		case OVS_CONS:
-			return (ovs_expr){ OVS_SYMBOL, .p=e.p->cons.table->qualifier };
+		case OVS_LIST:
+		case OVS_VECTOR:
+			return (ovs_expr){ OVS_SYMBOL, .p=cell_qualifier(e) };
 
 		case OVS_FUNCTION:
 			;
-			const ovs_function_data* f = &e.p->function;
-			ovs_expr r = f->type->represent(f);
-			ovs_expr q = ovs_qualifier(r);
-			ovs_dealias(r);
-			return q;
+			return ovs_qualifier(ovs_function_representation(&e.p->function));
 
 		case OVS_CHARACTER:
 			return ovs_root_symbol(OVS_TEXT_CHARACTER)->expr;
 
 		case OVS_STRING:
+		case OVS_SHORT_STRING:
 			return ovs_root_symbol(OVS_TEXT_STRING)->expr;
 
 		default:
@@ -242,11 +331,7 @@ ovs_expr ovs_qualifier(ovs_expr e) {
 
 UChar* ovs_name(const ovs_expr e) {
 	if (e.type == OVS_FUNCTION) {
-		const ovs_function_data* f = &e.p->function;
-		ovs_expr r = f->type->represent(f);
-		UChar* name = ovs_name(r);
-		ovs_dealias(r);
-		return name;
+		return ovs_name(ovs_function_representation(&e.p->function));
 	}
 	if (e.type != OVS_SYMBOL) {
 		assert(false);
@@ -254,7 +339,7 @@ UChar* ovs_name(const ovs_expr e) {
 	if (e.p->symbol.node == NULL) {
 		ovs_root_symbol_data* symbol = ovs_root_symbol(e.p->symbol.offset);
 		UChar* s = malloc(sizeof(UChar) * (symbol->nameSize + 1));
-		u_strcpy(s, symbol->name, symbol->nameSize + 1);
+		u_strncpy(s, symbol->name, symbol->nameSize + 1);
 		return s;
 	}
 	uint32_t size = bdtrie_key_size(e.p->symbol.node);
@@ -273,86 +358,315 @@ ovs_expr ovs_character(UChar32 cp) {
 	return (ovs_expr){ OVS_CHARACTER, .character=cp };
 }
 
-ovs_expr ovs_cstring(UConverter* c, char* s) {
-	int32_t size = strlen(s);
-	int32_t destSize = size * sizeof(UChar);
+ovs_expr ovs_integer(int64_t i) {
+	return (ovs_expr){ OVS_INTEGER, .integer=i };
+}
 
-	ovs_expr_ref* r = ref(offsetof(ovs_string_data, string) + sizeof(UChar) * (destSize + 1), 1);
+ovs_expr ovs_float(double d) {
+	return (ovs_expr){ OVS_FLOAT, .floating=d };
+}
 
-	UErrorCode error = 0;
-	uint32_t len = ucnv_toUChars(c,
-			r->string.string, destSize,
-			s, size,
-			&error);
+ovs_expr_ref* string_ref(uint32_t len) {
+	ovs_expr_ref* r = ref(offsetof(ovs_string_data, string) + sizeof(UChar) * (len + 1), 1);
+	r->string.length = len;
+	r->string.string[len] = u'\0';
+	return r;
+}
 
-	if (len != size) {
-		ovs_expr_ref* oldR = r;
+ovs_expr short_string(uint32_t len, const UChar* s) {
+	ovs_expr e = { OVS_SHORT_STRING, .short_string={ { 0 }, len } };
+	if (len > 0) {
+		memcpy(e.short_string.string, s, sizeof(UChar) * len);
+	}
+	return e;
+}
 
-		destSize = len * sizeof(UChar);
-		r = ref(offsetof(ovs_string_data, string) + sizeof(UChar) * (len + 1), 1);
+ovs_expr ovs_cstring(UConverter* c, char* s) {
+	int32_t size = strlen(s);
 
-		memcpy(r->string.string, oldR->string.string, destSize);
+	UErrorCode error = 0;
+	int32_t len = ucnv_toUChars(c, NULL, 0, s, size, &error);
 
-		free(oldR);
+	error = 0;
+	if (len <= OVS_SHORT_STRING_MAX) {
+		UChar chars[OVS_SHORT_STRING_MAX + 1];
+		ucnv_toUChars(c, chars, len + 1, s, size, &error);
+		return short_string(len, chars);
 	}
 
-	r->string.string[len] = u'\0';
+	ovs_expr_ref* r = string_ref(len);
+	ucnv_toUChars(c, r->string.string, len + 1, s, size, &error);
+
 	return (ovs_expr){ OVS_STRING, .p=r };
 }
 
 ovs_expr ovs_string(uint32_t len, UChar* s) {
-	ovs_expr_ref* r = ref(offsetof(ovs_string_data, string) + sizeof(UChar) * (len + 1), 1);
+	if (len <= OVS_SHORT_STRING_MAX) {
+		return short_string(len, s);
+	}
+
+	ovs_expr_ref* r = string_ref(len);
 	memcpy(r->string.string, s, sizeof(UChar) * len);
-	r->string.string[len] = u'\0';
 	return (ovs_expr){ OVS_STRING, .p=r };
 }
 
-ovs_expr ovs_cons(ovs_table* t, const ovs_expr car, const ovs_expr cdr) {
-	if (car.type == OVS_CHARACTER && cdr.type == OVS_STRING) {
-		bool single = !U_IS_SURROGATE(car.character);
-		int32_t head = single ? 1 : 2;
-		int32_t len = u_strlen(cdr.p->string.string);
-
-		ovs_expr_ref* r = ref(sizeof(UChar) * (len + head), 1);
-		memcpy(r->string.string + head, cdr.p->string.string, sizeof(UChar) * len);
-		if (single) {
-			r->string.string[0] = car.character;
-		} else {
-			r->string.string[0] = U16_LEAD(car.character);
-			r->string.string[1] = U16_TRAIL(car.character);
-		}
-		return (ovs_expr){ OVS_STRING, .p=r };
+bool ovs_is_string(ovs_expr e) {
+	return e.type == OVS_STRING || e.type == OVS_SHORT_STRING;
+}
+
+/*
+ * The characters of a short string live inside the expression itself,
+ * so the result is only valid for as long as *e is.
+ */
+const UChar* ovs_string_chars(const ovs_expr* e, uint32_t* length) {
+	switch (e->type) {
+		case OVS_STRING:
+			*length = e->p->string.length;
+			return e->p->string.string;
+
+		case OVS_SHORT_STRING:
+			*length = e->short_string.length;
+			return e->short_string.string;
+
+		default:
+			assert(false);
+	}
+}
+
+/*
+ * Takes ownership of car and cdr.
+ */
+ovs_expr cons_cell(ovs_table* t, const ovs_expr car, const ovs_expr cdr) {
+	if (t->qualifier != NULL) {
+		ovs_ref(t->qualifier);
 	}
 
 	ovs_expr_ref* r = ref(sizeof(ovs_cons_data), 1);
 	r->cons.table = t;
 	r->cons.car = car;
 	r->cons.cdr = cdr;
-	ovs_alias(car);
-	ovs_alias(cdr);
 	return (ovs_expr){ OVS_CONS, .p=r };
 }
 
+/*
+ * Hash consing
+ *
+ * A table may keep a weak set of the cons cells allocated against it,
+ * keyed on the identity of their car and cdr. Building the same
+ * structure twice then yields the same cells. Cells remove themselves
+ * from the set when they are freed.
+ */
+
+#define CONS_SET_INITIAL_CAPACITY 64
+#define CONS_SET_TOMBSTONE ((const ovs_expr_ref*)1)
+
+typedef struct ovs_cons_set {
+	uint32_t capacity; // power of two
+	uint32_t size;
+	uint32_t used; // including tombstones
+	const ovs_expr_ref** cells;
+} ovs_cons_set;
+
+uint64_t identity_hash(const ovs_expr e) {
+	uint64_t h;
+	switch (e.type) {
+		case OVS_CHARACTER:
+			h = e.character;
+			break;
+		case OVS_INTEGER:
+			h = e.integer;
+			break;
+		case OVS_FLOAT:
+			memcpy(&h, &e.floating, sizeof(h));
+			break;
+		case OVS_SHORT_STRING:
+			h = e.short_string.length;
+			for (int i = 0; i < e.short_string.length; i++) {
+				h = h * 31 + e.short_string.string[i];
+			}
+			break;
+		default:
+			h = (uintptr_t)e.p + e.offset;
+			break;
+	}
+	h = (h ^ (h >> 31)) * 0xbf58476d1ce4e5b9u;
+	return h ^ (h >> 29) ^ e.type;
+}
+
+bool is_identical(const ovs_expr a, const ovs_expr b) {
+	if (a.type != b.type) {
+		return false;
+	}
+	switch (a.type) {
+		case OVS_CHARACTER:
+			return a.character == b.character;
+		case OVS_INTEGER:
+			return a.integer == b.integer;
+		case OVS_FLOAT:
+			return !memcmp(&a.floating, &b.floating, sizeof(double));
+		case OVS_SHORT_STRING:
+			return a.short_string.length == b.short_string.length
+				&& !memcmp(a.short_string.string, b.short_string.string, sizeof(UChar) * a.short_string.length);
+		default:
+			return a.p == b.p && a.offset == b.offset;
+	}
+}
+
+uint32_t cons_hash(const ovs_expr car, const ovs_expr cdr) {
+	uint64_t h = identity_hash(car) * 31 + identity_hash(cdr);
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+const ovs_expr_ref* find_cons(ovs_cons_set* s, const ovs_expr car, const ovs_expr cdr) {
+	uint32_t mask = s->capacity - 1;
+	for (uint32_t i = cons_hash(car, cdr) & mask; s->cells[i] != NULL; i = (i + 1) & mask) {
+		const ovs_expr_ref* r = s->cells[i];
+		if (r != CONS_SET_TOMBSTONE
+				&& is_identical(r->cons.car, car)
+				&& is_identical(r->cons.cdr, cdr)) {
+			return r;
+		}
+	}
+	return NULL;
+}
+
+void insert_cons(ovs_cons_set* s, const ovs_expr_ref* r);
+
+void resize_conses(ovs_cons_set* s, uint32_t capacity) {
+	const ovs_expr_ref** cells = s->cells;
+	uint32_t old_capacity = s->capacity;
+
+	s->capacity = capacity;
+	s->size = 0;
+	s->used = 0;
+	s->cells = calloc(capacity, sizeof(ovs_expr_ref*));
+
+	for (uint32_t i = 0; i < old_capacity; i++) {
+		if (cells[i] != NULL && cells[i] != CONS_SET_TOMBSTONE) {
+			insert_cons(s, cells[i]);
+		}
+	}
+	free(cells);
+}
+
+void insert_cons(ovs_cons_set* s, const ovs_expr_ref* r) {
+	if (2 * (s->used + 1) > s->capacity) {
+		// rehash in place if most of the load is tombstones
+		resize_conses(s, 4 * (s->size + 1) > s->capacity ? s->capacity * 2 : s->capacity);
+	}
+	uint32_t mask = s->capacity - 1;
+	uint32_t i = cons_hash(r->cons.car, r->cons.cdr) & mask;
+	while (s->cells[i] != NULL) {
+		i = (i + 1) & mask;
+	}
+	s->cells[i] = r;
+	s->size++;
+	s->used++;
+}
+
+void remove_cons(ovs_cons_set* s, const ovs_expr_ref* r) {
+	uint32_t mask = s->capacity - 1;
+	for (uint32_t i = cons_hash(r->cons.car, r->cons.cdr) & mask; s->cells[i] != NULL; i = (i + 1) & mask) {
+		if (s->cells[i] == r) {
+			s->cells[i] = CONS_SET_TOMBSTONE;
+			s->size--;
+			return;
+		}
+	}
+}
+
+void ovs_table_hash_cons(ovs_table* t, bool enabled) {
+	if (enabled && t->conses == NULL) {
+		t->conses = malloc(sizeof(ovs_cons_set));
+		t->conses->capacity = CONS_SET_INITIAL_CAPACITY;
+		t->conses->size = 0;
+		t->conses->used = 0;
+		t->conses->cells = calloc(CONS_SET_INITIAL_CAPACITY, sizeof(ovs_expr_ref*));
+
+	} else if (!enabled && t->conses != NULL) {
+		free(t->conses->cells);
+		free(t->conses);
+		t->conses = NULL;
+	}
+}
+
+ovs_expr ovs_cons(ovs_table* t, const ovs_expr car, const ovs_expr cdr) {
+	if (car.type == OVS_CHARACTER && ovs_is_string(cdr)) {
+		uint32_t len;
+		const UChar* tail = ovs_string_chars(&cdr, &len);
+
+		UChar head[2];
+		int32_t head_len = 0;
+		U16_APPEND_UNSAFE(head, head_len, car.character);
+
+		if (head_len + len <= OVS_SHORT_STRING_MAX) {
+			ovs_expr e = short_string(head_len, head);
+			memcpy(e.short_string.string + head_len, tail, sizeof(UChar) * len);
+			e.short_string.length += len;
+			return e;
+		}
+
+		ovs_expr_ref* r = string_ref(head_len + len);
+		memcpy(r->string.string, head, sizeof(UChar) * head_len);
+		memcpy(r->string.string + head_len, tail, sizeof(UChar) * len);
+		return (ovs_expr){ OVS_STRING, .p=r };
+	}
+
+	if (t->conses != NULL) {
+		const ovs_expr_ref* r = find_cons(t->conses, car, cdr);
+		if (r != NULL) {
+			return (ovs_expr){ OVS_CONS, .p=ovs_ref(r) };
+		}
+		ovs_expr e = cons_cell(t, ovs_alias(car), ovs_alias(cdr));
+		insert_cons(t->conses, e.p);
+		return e;
+	}
+
+	return cons_cell(t, ovs_alias(car), ovs_alias(cdr));
+}
+
+/*
+ * The cdr of a contiguous list is either a view of the same block at the
+ * next offset or, after the last element, the shared tail. Borrowed.
+ */
+ovs_expr list_cdr(const ovs_expr e) {
+	if (e.offset + 1 < e.p->list.size) {
+		return (ovs_expr){ OVS_LIST, e.offset + 1, .p=e.p };
+	}
+	return e.p->list.tail;
+}
+
+ovs_expr vector_cdr(const ovs_expr e) {
+	if (e.offset + 1 < e.p->vector.size) {
+		return (ovs_expr){ OVS_VECTOR, e.offset + 1, .p=e.p };
+	}
+	return ovs_root_symbol(OVS_DATA_NIL)->expr;
+}
+
 ovs_expr ovs_car(const ovs_expr e) {
 	switch (e.type) {
 		case OVS_CONS:
 			return ovs_alias(e.p->cons.car);
 
+		case OVS_LIST:
+			return ovs_alias(e.p->list.elements[e.offset]);
+
+		case OVS_VECTOR:
+			return ovs_alias(e.p->vector.elements[e.offset]);
+
 		case OVS_STRING:
+		case OVS_SHORT_STRING:
 			;
-			bool single = U16_IS_SINGLE(e.p->string.string[0]);
-			UChar32 cp = single
-				? e.p->string.string[0]
-				: U16_GET_SUPPLEMENTARY(e.p->string.string[0], e.p->string.string[1]);
+			uint32_t len;
+			const UChar* chars = ovs_string_chars(&e, &len);
+			UChar32 cp;
+			uint32_t i = 0;
+			U16_NEXT(chars, i, len, cp);
 			return ovs_character(cp);
 
 		case OVS_FUNCTION:
 			;
-			const ovs_function_data* f = &e.p->function;
-			ovs_expr rep = f->type->represent(f);
-			ovs_expr car = ovs_car(rep);
-			ovs_dealias(rep);
-			return car;
+			return ovs_car(ovs_function_representation(&e.p->function));
 
 		case OVS_CHARACTER:
 			printf("Cannot destruct character yet");
@@ -369,28 +683,27 @@ ovs_expr ovs_cdr(const ovs_expr e) {
 		case OVS_CONS:
 			return ovs_alias(e.p->cons.cdr);
 
+		case OVS_LIST:
+			return ovs_alias(list_cdr(e));
+
+		case OVS_VECTOR:
+			return ovs_alias(vector_cdr(e));
+
 		case OVS_STRING:
+		case OVS_SHORT_STRING:
 			;
-			bool single = U16_IS_SINGLE(e.p->string.string[0]);
-			int32_t head = single ? 1 : 2;
-			int32_t len = u_strlen(e.p->string.string);
-			len -= head;
-			if (len == 0) {
+			uint32_t len;
+			const UChar* chars = ovs_string_chars(&e, &len);
+			uint32_t head = 0;
+			U16_FWD_1(chars, head, len);
+			if (head == len) {
 				return ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
 			}
-			ovs_expr_ref* r = ref(offsetof(ovs_string_data, string) + sizeof(UChar) * len, 1);
-			u_strncpy(r->string.string, e.p->string.string, len);
-			r->string.string[len] = u'\0';
-
-			return (ovs_expr){ OVS_STRING, .p=r };
+			return ovs_string(len - head, (UChar*)chars + head);
 
 		case OVS_FUNCTION:
 			;
-			const ovs_function_data* f = &e.p->function;
-			ovs_expr rep = f->type->represent(f);
-			ovs_expr cdr = ovs_cdr(rep);
-			ovs_dealias(rep);
-			return cdr;
+			return ovs_cdr(ovs_function_representation(&e.p->function));
 
 		case OVS_CHARACTER:
 			printf("Cannot destruct character yet");
@@ -402,29 +715,422 @@ ovs_expr ovs_cdr(const ovs_expr e) {
 	}
 }
 
-bool ovs_is_eq(const ovs_expr a, const ovs_expr b) {
-	if (a.type != b.type) {
+bool is_pair(const ovs_expr e) {
+	return e.type == OVS_CONS || e.type == OVS_LIST || e.type == OVS_VECTOR;
+}
+
+ovs_expr pair_car(const ovs_expr e) {
+	switch (e.type) {
+		case OVS_CONS:
+			return e.p->cons.car;
+		case OVS_LIST:
+			return e.p->list.elements[e.offset];
+		default:
+			return e.p->vector.elements[e.offset];
+	}
+}
+
+ovs_expr pair_cdr(const ovs_expr e) {
+	switch (e.type) {
+		case OVS_CONS:
+			return e.p->cons.cdr;
+		case OVS_LIST:
+			return list_cdr(e);
+		default:
+			return vector_cdr(e);
+	}
+}
+
+/*
+ * Hashes are cached in shared values, which may be hashed by several
+ * threads at once. Each would store the same hash, so relaxed accesses
+ * are enough.
+ */
+uint32_t load_hash(const ovs_expr_ref* r) {
+	return atomic_load_explicit(&((ovs_expr_ref*)r)->hash, memory_order_relaxed);
+}
+
+void store_hash(const ovs_expr_ref* r, uint32_t h) {
+	atomic_store_explicit(&((ovs_expr_ref*)r)->hash, h, memory_order_relaxed);
+}
+
+/*
+ * The hash of e if it has already been computed, otherwise zero.
+ */
+uint32_t cached_hash(const ovs_expr e) {
+	switch (e.type) {
+		case OVS_CONS:
+		case OVS_FUNCTION:
+		case OVS_STRING:
+		case OVS_BIG_INTEGER:
+		case OVS_ARRAY:
+		case OVS_BLOB:
+		case OVS_MAP:
+		case OVS_SEQUENCE:
+			return load_hash(e.p);
+		case OVS_LIST:
+		case OVS_VECTOR:
+			return e.offset == 0 ? load_hash(e.p) : 0;
+		default:
+			return 0;
+	}
+}
+
+bool is_map_eq(const ovs_map_data* a, const ovs_map_data* b) {
+	if (a->count != b->count
+			|| a->datamap != b->datamap
+			|| a->nodemap != b->nodemap
+			|| a->entries != b->entries
+			|| a->nodes != b->nodes) {
 		return false;
 	}
+
+	if (a->entries > 0 && a->datamap == 0) {
+		// collision nodes may hold the same entries in any order
+		for (uint32_t i = 0; i < a->entries; i++) {
+			bool found = false;
+			for (uint32_t j = 0; j < b->entries && !found; j++) {
+				found = ovs_is_eq(a->slots[2 * i], b->slots[2 * j])
+					&& ovs_is_eq(a->slots[2 * i + 1], b->slots[2 * j + 1]);
+			}
+			if (!found) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	for (uint32_t i = 0; i < 2 * a->entries + a->nodes; i++) {
+		if (!ovs_is_eq(a->slots[i], b->slots[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Sequences of equal elements may be split into nodes differently, so are
+ * compared element by element.
+ */
+bool is_sequence_eq(const ovs_expr a, const ovs_expr b) {
+	if (ovs_sequence_length(a) != ovs_sequence_length(b)) {
+		return false;
+	}
+
+	ovs_sequence_iterator ia;
+	ovs_sequence_iterator ib;
+	ovs_sequence_iterate(a, &ia);
+	ovs_sequence_iterate(b, &ib);
+	ovs_expr x;
+	ovs_expr y;
+	while (ovs_sequence_next(&ia, &x) && ovs_sequence_next(&ib, &y)) {
+		if (!ovs_is_eq(x, y)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool is_atom_eq(const ovs_expr a, const ovs_expr b) {
 	switch (a.type) {
-		case OVS_SYMBOL:
-			return a.p == b.p;
-		case OVS_CONS:
-			return ovs_is_eq(a.p->cons.car, b.p->cons.car) && ovs_is_eq(a.p->cons.cdr, b.p->cons.cdr);
 		case OVS_FUNCTION:
 			;
 			const ovs_function_data* fa = &a.p->function;
 			const ovs_function_data* fb = &b.p->function;
 			return fa->type == fb->type
-				&& ovs_is_eq(fa->type->represent(fa), fb->type->represent(fb));
+				&& ovs_is_eq(ovs_function_representation(fa), ovs_function_representation(fb));
+		case OVS_STRING:
+			;
+			const ovs_string_data* sa = &a.p->string;
+			const ovs_string_data* sb = &b.p->string;
+			return sa->length == sb->length
+				&& !memcmp(sa->string, sb->string, sizeof(UChar) * sa->length);
+		case OVS_BIG_INTEGER:
+			;
+			const ovs_big_integer_data* ia = &a.p->big_integer;
+			const ovs_big_integer_data* ib = &b.p->big_integer;
+			return ia->negative == ib->negative
+				&& ia->size == ib->size
+				&& !memcmp(ia->limbs, ib->limbs, sizeof(uint32_t) * ia->size);
+		case OVS_ARRAY:
+			;
+			const ovs_array_data* aa = &a.p->array;
+			const ovs_array_data* ab = &b.p->array;
+			return aa->kind == ab->kind
+				&& aa->size == ab->size
+				&& !memcmp(aa->int64s, ab->int64s, sizeof(int64_t) * aa->size);
+		case OVS_BLOB:
+			return a.p->blob.size == b.p->blob.size
+				&& !memcmp(a.p->blob.bytes, b.p->blob.bytes, a.p->blob.size);
+		case OVS_MAP:
+			return is_map_eq(&a.p->map, &b.p->map);
+		case OVS_SEQUENCE:
+			return is_sequence_eq(a, b);
+		default:
+			// symbols and unboxed values are equal only if identical
+			return false;
+	}
+}
+
+/*
+ * Pairs are compared by descending into the car and deferring the cdr on
+ * an explicit stack. Identical subtrees are skipped without being
+ * traversed, and subtrees with differing cached hashes are rejected.
+ */
+bool ovs_is_eq(const ovs_expr a, const ovs_expr b) {
+	ovs_expr stack[2 * WORK_STACK_SIZE];
+	ovs_expr* pending = stack;
+	uint32_t capacity = WORK_STACK_SIZE;
+	uint32_t count = 0;
+
+	bool eq = true;
+	ovs_expr x = a;
+	ovs_expr y = b;
+	while (true) {
+		if (!is_identical(x, y)) {
+			uint32_t hx = cached_hash(x);
+			uint32_t hy = cached_hash(y);
+			if (hx != 0 && hy != 0 && hx != hy) {
+				eq = false;
+				break;
+			}
+
+			if (is_pair(x) && is_pair(y)) {
+				if (count == capacity) {
+					capacity *= 2;
+					if (pending == stack) {
+						pending = malloc(sizeof(ovs_expr) * 2 * capacity);
+						memcpy(pending, stack, sizeof(stack));
+					} else {
+						pending = realloc(pending, sizeof(ovs_expr) * 2 * capacity);
+					}
+				}
+				pending[2 * count] = pair_cdr(x);
+				pending[2 * count + 1] = pair_cdr(y);
+				count++;
+
+				x = pair_car(x);
+				y = pair_car(y);
+				continue;
+			}
+
+			if (x.type != y.type || !is_atom_eq(x, y)) {
+				eq = false;
+				break;
+			}
+		}
+
+		if (count == 0) {
+			break;
+		}
+		count--;
+		x = pending[2 * count];
+		y = pending[2 * count + 1];
+	}
+
+	if (pending != stack) {
+		free(pending);
+	}
+	return eq;
+}
+
+/*
+ * Structural hashing, consistent with ovs_is_eq. Hashes of heap values
+ * are cached in their ref, with zero reserved to mean "not computed".
+ */
+
+uint32_t hash_mix(uint32_t h, uint32_t v) {
+	return h ^ (v + 0x9e3779b9u + (h << 6) + (h >> 2));
+}
+
+uint32_t hash_finish(uint32_t h) {
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	return h == 0 ? 1 : h;
+}
+
+uint32_t hash_chars(uint32_t length, const UChar* chars) {
+	uint32_t h = 2166136261u;
+	for (uint32_t i = 0; i < length; i++) {
+		h = (h ^ chars[i]) * 16777619u;
+	}
+	return hash_finish(h);
+}
+
+uint32_t hash_pair(uint32_t car, uint32_t cdr) {
+	return hash_finish(hash_mix(hash_mix(0x5a17u, car), cdr));
+}
+
+/*
+ * Hash the elements of a contiguous list or vector from its offset, from
+ * the last element back.
+ */
+uint32_t hash_elements(const ovs_expr e, uint32_t size, const ovs_expr* elements, ovs_expr tail) {
+	if (e.offset == 0 && load_hash(e.p) != 0) {
+		return load_hash(e.p);
+	}
+	uint32_t h = ovs_hash(tail);
+	for (uint32_t i = size; i > e.offset; i--) {
+		h = hash_pair(ovs_hash(elements[i - 1]), h);
+	}
+	if (e.offset == 0) {
+		store_hash(e.p, h);
+	}
+	return h;
+}
+
+/*
+ * Walk down the cdrs to the first cell which already has a hash, then
+ * fill in hashes on the way back up, so long lists don't recurse.
+ */
+uint32_t hash_cons(const ovs_expr e) {
+	const ovs_expr_ref* stack[WORK_STACK_SIZE];
+	const ovs_expr_ref** cells = stack;
+	uint32_t capacity = WORK_STACK_SIZE;
+	uint32_t count = 0;
+
+	ovs_expr tail = e;
+	while (tail.type == OVS_CONS && load_hash(tail.p) == 0) {
+		if (count == capacity) {
+			capacity *= 2;
+			if (cells == stack) {
+				cells = malloc(sizeof(ovs_expr_ref*) * capacity);
+				memcpy(cells, stack, sizeof(stack));
+			} else {
+				cells = realloc(cells, sizeof(ovs_expr_ref*) * capacity);
+			}
+		}
+		cells[count++] = tail.p;
+		tail = tail.p->cons.cdr;
+	}
+
+	uint32_t h = tail.type == OVS_CONS ? load_hash(tail.p) : ovs_hash(tail);
+	while (count > 0) {
+		const ovs_expr_ref* r = cells[--count];
+		h = hash_pair(ovs_hash(r->cons.car), h);
+		store_hash(r, h);
+	}
+
+	if (cells != stack) {
+		free(cells);
+	}
+	return h;
+}
+
+uint32_t ovs_hash(const ovs_expr e) {
+	switch (e.type) {
+		case OVS_SYMBOL:
+			return hash_finish((uint32_t)((uintptr_t)e.p >> 4) ^ (uint32_t)((uint64_t)(uintptr_t)e.p >> 32));
+
+		case OVS_CONS:
+			return hash_cons(e);
+
+		case OVS_LIST:
+			return hash_elements(e, e.p->list.size, e.p->list.elements, e.p->list.tail);
+
+		case OVS_VECTOR:
+			return hash_elements(e, e.p->vector.size, e.p->vector.elements, ovs_root_symbol(OVS_DATA_NIL)->expr);
+
+		case OVS_FUNCTION:
+			if (load_hash(e.p) == 0) {
+				const ovs_function_data* f = &e.p->function;
+				uint32_t h = hash_mix((uint32_t)(uintptr_t)f->type, ovs_hash(ovs_function_representation(f)));
+				store_hash(e.p, hash_finish(h));
+			}
+			return load_hash(e.p);
+
 		case OVS_CHARACTER:
-			return a.character == b.character;
+			return hash_finish(hash_mix(OVS_CHARACTER, e.character));
+
 		case OVS_STRING:
-			return !u_strcmp(a.p->string.string, b.p->string.string);
+			if (load_hash(e.p) == 0) {
+				store_hash(e.p, hash_chars(e.p->string.length, e.p->string.string));
+			}
+			return load_hash(e.p);
+
+		case OVS_SHORT_STRING:
+			return hash_chars(e.short_string.length, e.short_string.string);
+
 		case OVS_INTEGER:
-			return a.integer == b.integer;
+			return hash_finish(hash_mix((uint32_t)e.integer, (uint32_t)((uint64_t)e.integer >> 32)));
+
+		case OVS_BIG_INTEGER:
+			if (load_hash(e.p) == 0) {
+				const ovs_big_integer_data* b = &e.p->big_integer;
+				uint32_t h = b->negative;
+				for (uint32_t i = 0; i < b->size; i++) {
+					h = hash_mix(h, b->limbs[i]);
+				}
+				store_hash(e.p, hash_finish(h));
+			}
+			return load_hash(e.p);
+
+		case OVS_FLOAT:
+			;
+			uint64_t bits;
+			memcpy(&bits, &e.floating, sizeof(bits));
+			return hash_finish(hash_mix(hash_mix(OVS_FLOAT, (uint32_t)bits), (uint32_t)(bits >> 32)));
+
+		case OVS_BLOB:
+			if (load_hash(e.p) == 0) {
+				uint32_t h = 2166136261u;
+				for (uint64_t i = 0; i < e.p->blob.size; i++) {
+					h = (h ^ e.p->blob.bytes[i]) * 16777619u;
+				}
+				store_hash(e.p, hash_finish(hash_mix(h, OVS_BLOB)));
+			}
+			return load_hash(e.p);
+
+		case OVS_MAP:
+			if (load_hash(e.p) == 0) {
+				const ovs_map_data* m = &e.p->map;
+				uint32_t h = hash_mix(OVS_MAP, m->count);
+				if (m->entries > 0 && m->datamap == 0) {
+					// the order of entries in a collision node is arbitrary
+					uint32_t sum = 0;
+					for (uint32_t i = 0; i < m->entries; i++) {
+						sum += hash_pair(ovs_hash(m->slots[2 * i]), ovs_hash(m->slots[2 * i + 1]));
+					}
+					h = hash_mix(h, sum);
+				} else {
+					h = hash_mix(hash_mix(h, m->datamap), m->nodemap);
+					for (uint32_t i = 0; i < 2 * m->entries + m->nodes; i++) {
+						h = hash_mix(h, ovs_hash(m->slots[i]));
+					}
+				}
+				store_hash(e.p, hash_finish(h));
+			}
+			return load_hash(e.p);
+
+		case OVS_SEQUENCE:
+			if (load_hash(e.p) == 0) {
+				uint32_t h = hash_mix(OVS_SEQUENCE, ovs_sequence_length(e));
+				ovs_sequence_iterator i;
+				ovs_sequence_iterate(e, &i);
+				ovs_expr element;
+				while (ovs_sequence_next(&i, &element)) {
+					h = hash_mix(h, ovs_hash(element));
+				}
+				store_hash(e.p, hash_finish(h));
+			}
+			return load_hash(e.p);
+
+		case OVS_ARRAY:
+			if (load_hash(e.p) == 0) {
+				const ovs_array_data* a = &e.p->array;
+				uint32_t h = a->kind;
+				for (uint32_t i = 0; i < a->size; i++) {
+					uint64_t element = a->int64s[i];
+					h = hash_mix(hash_mix(h, (uint32_t)element), (uint32_t)(element >> 32));
+				}
+				store_hash(e.p, hash_finish(h));
+			}
+			return load_hash(e.p);
+
+		default:
+			assert(false);
 	}
-	return false;
 }
 
 void ovs_elem_dump(const ovs_expr s);
@@ -469,8 +1175,11 @@ void ovs_elem_dump(const ovs_expr s) {
 
 	switch (s.type) {
 		case OVS_STRING:
+		case OVS_SHORT_STRING:
 			;
-			u_printf_u(u"\"%S\"", s.p->string.string);
+			uint32_t len;
+			const UChar* chars = ovs_string_chars(&s, &len);
+			u_printf_u(u"\"%.*S\"", len, chars);
 			break;
 		case OVS_CHARACTER:
 			u_printf_u(u"unicode:%04x", s.character);
@@ -478,6 +1187,56 @@ void ovs_elem_dump(const ovs_expr s) {
 		case OVS_INTEGER:
 			printf("%li", s.integer);
 			break;
+		case OVS_BIG_INTEGER:
+			;
+			uint32_t digits;
+			UChar* text = ovs_integer_text(s, &digits);
+			u_printf_u(u"%S", text);
+			free(text);
+			break;
+		case OVS_FLOAT:
+			printf("%.17g", s.floating);
+			break;
+		case OVS_BLOB:
+			printf("blob:%lu", s.p->blob.size);
+			break;
+		case OVS_MAP:
+			printf("map:%u", s.p->map.count);
+			break;
+		case OVS_ARRAY:
+			printf("(");
+			for (uint32_t i = 0; i < s.p->array.size; i++) {
+				if (i > 0) {
+					printf(" ");
+				}
+				ovs_expr element = ovs_array_index(s, i);
+				ovs_elem_dump(element);
+			}
+			printf(")");
+			break;
+		case OVS_SEQUENCE:
+			printf("(");
+			ovs_sequence_iterator iterator;
+			ovs_sequence_iterate(s, &iterator);
+			ovs_expr element;
+			for (bool first = true; ovs_sequence_next(&iterator, &element); first = false) {
+				if (!first) {
+					printf(" ");
+				}
+				ovs_elem_dump(element);
+			}
+			printf(")");
+			break;
+		case OVS_VECTOR:
+			printf("(");
+			for (uint32_t i = s.offset; i < s.p->vector.size; i++) {
+				if (i > s.offset) {
+					printf(" ");
+				}
+				ovs_elem_dump(s.p->vector.elements[i]);
+			}
+			printf(")");
+			break;
 		default:
 			if (ovs_is_eq(s, ovs_root_symbol(OVS_DATA_NIL)->expr)) {
 				printf("()");
@@ -545,7 +1304,9 @@ void ovs_dump_context(const ovs_context* c) {
 ovs_expr ovs_alias(ovs_expr e) {
 	switch (e.type) {
 		case OVS_CHARACTER:
+		case OVS_SHORT_STRING:
 		case OVS_INTEGER:
+		case OVS_FLOAT:
 			break;
 		default:
 			ovs_ref(e.p);
@@ -556,7 +1317,9 @@ ovs_expr ovs_alias(ovs_expr e) {
 void ovs_dealias(ovs_expr e) {
 	switch (e.type) {
 		case OVS_CHARACTER:
+		case OVS_SHORT_STRING:
 		case OVS_INTEGER:
+		case OVS_FLOAT:
 			break;
 		default:
 			ovs_free(e.type, e.p);
@@ -568,36 +1331,197 @@ const ovs_expr_ref* ovs_ref(const ovs_expr_ref* r) {
 	return r;
 }
 
-void ovs_free(ovs_expr_type t, const ovs_expr_ref* r) {
-	if (atomic_fetch_add(&((ovs_expr_ref*)r)->ref_count, -1) > 1) {
-		return;
-	}
-	switch (t) {
+bool has_ref(ovs_expr e) {
+	switch (e.type) {
 		case OVS_CHARACTER:
+		case OVS_SHORT_STRING:
 		case OVS_INTEGER:
-			break;
-		case OVS_SYMBOL:
-			if (r->symbol.node != NULL) {
-				bdtrie_delete(r->symbol.node);
-			}
-			break;
-		case OVS_CONS:
-			if (r->cons.table->qualifier != NULL) {
-				ovs_free(OVS_SYMBOL, r->cons.table->qualifier);
+		case OVS_FLOAT:
+			return false;
+		default:
+			return true;
+	}
+}
+
+/*
+ * An entry on the work list of ovs_free: either an expression to release,
+ * or a block already released whose elements are being released in place,
+ * with the index of the next of them.
+ */
+typedef struct release_work {
+	ovs_expr e;
+	uint32_t next;
+	bool walking;
+} release_work;
+
+release_work* push_pending(release_work* pending, release_work* stack, uint32_t* capacity, uint32_t count) {
+	if (count < *capacity) {
+		return pending;
+	}
+	*capacity *= 2;
+	if (pending == stack) {
+		pending = malloc(sizeof(release_work) * *capacity);
+		memcpy(pending, stack, sizeof(release_work) * count);
+	} else {
+		pending = realloc(pending, sizeof(release_work) * *capacity);
+	}
+	return pending;
+}
+
+/*
+ * Take the next expression to release from the work list. A block being
+ * walked gives up its elements one at a time, and once they are done it
+ * is freed, and for a list its tail is next.
+ */
+bool next_pending(release_work* pending, uint32_t* count, ovs_expr* e) {
+	while (*count > 0) {
+		release_work* w = &pending[*count - 1];
+		if (!w->walking) {
+			*e = w->e;
+			(*count)--;
+			return true;
+		}
+
+		const ovs_expr_ref* r = w->e.p;
+		bool list = w->e.type == OVS_LIST;
+		uint32_t size = list ? r->list.size : r->vector.size;
+		const ovs_expr* elements = list ? r->list.elements : r->vector.elements;
+		while (w->next < size) {
+			ovs_expr element = elements[w->next++];
+			if (has_ref(element)) {
+				*e = element;
+				return true;
 			}
-			ovs_dealias(r->cons.car);
-			ovs_dealias(r->cons.cdr);
-			free((void*)r);
-			break;
-		case OVS_FUNCTION:
-			r->function.type->free(&r->function + 1);
-			free((void*)r);
-			break;
-		case OVS_STRING:
+		}
+		(*count)--;
+		if (list) {
+			*e = r->list.tail;
 			free((void*)r);
+			return true;
+		}
+		free((void*)r);
+	}
+	return false;
+}
+
+/*
+ * Releasing a cons may release its car and cdr in turn. Rather than
+ * recursing we descend into the car and keep the cdr on a work list, so
+ * a long list needs only one pending entry per level of nesting and the
+ * stack spills onto the heap rather than overflowing. A contiguous list
+ * or vector stays on the work list while its elements are released where
+ * they lie, so it too needs only one entry.
+ */
+void ovs_free(ovs_expr_type t, const ovs_expr_ref* r) {
+	release_work stack[WORK_STACK_SIZE];
+	release_work* pending = stack;
+	uint32_t capacity = WORK_STACK_SIZE;
+	uint32_t count = 0;
+
+	ovs_expr e = { t, .p=r };
+	while (true) {
+		r = e.p;
+
+		if (!has_ref(e) || atomic_fetch_add(&((ovs_expr_ref*)r)->ref_count, -1) > 1) {
+			if (!next_pending(pending, &count, &e)) {
+				break;
+			}
+			continue;
+		}
+
+		switch (e.type) {
+			case OVS_SYMBOL:
+				if (r->symbol.node != NULL) {
+					bdtrie_delete(r->symbol.node);
+				}
+				break;
+			case OVS_CONS:
+				if (r->cons.table->conses != NULL) {
+					remove_cons(r->cons.table->conses, r);
+				}
+				if (r->cons.table->qualifier != NULL) {
+					ovs_free(OVS_SYMBOL, r->cons.table->qualifier);
+				}
+				ovs_expr car = r->cons.car;
+				ovs_expr cdr = r->cons.cdr;
+				free((void*)r);
+
+				if (has_ref(car)) {
+					pending = push_pending(pending, stack, &capacity, count);
+					pending[count++] = (release_work){ cdr, 0, false };
+					e = car;
+				} else {
+					e = cdr;
+				}
+				continue;
+			case OVS_LIST:
+				if (r->list.table->qualifier != NULL) {
+					ovs_free(OVS_SYMBOL, r->list.table->qualifier);
+				}
+				pending = push_pending(pending, stack, &capacity, count);
+				pending[count++] = (release_work){ e, 0, true };
+				break;
+			case OVS_VECTOR:
+				if (r->vector.base != NULL) {
+					e = (ovs_expr){ OVS_VECTOR, .p=r->vector.base };
+					free((void*)r);
+					continue;
+				}
+				pending = push_pending(pending, stack, &capacity, count);
+				pending[count++] = (release_work){ e, 0, true };
+				break;
+			case OVS_MAP:
+				for (uint32_t i = 0; i < 2 * r->map.entries + r->map.nodes; i++) {
+					if (has_ref(r->map.slots[i])) {
+						pending = push_pending(pending, stack, &capacity, count);
+						pending[count++] = (release_work){ r->map.slots[i], 0, false };
+					}
+				}
+				free((void*)r);
+				break;
+			case OVS_SEQUENCE:
+				for (uint32_t i = 0; i < r->sequence.count; i++) {
+					if (has_ref(r->sequence.slots[i])) {
+						pending = push_pending(pending, stack, &capacity, count);
+						pending[count++] = (release_work){ r->sequence.slots[i], 0, false };
+					}
+				}
+				free((void*)r);
+				break;
+			case OVS_BLOB:
+				if (r->blob.mapped != 0) {
+					munmap((void*)r->blob.bytes, r->blob.mapped);
+				}
+				if (r->blob.base != NULL) {
+					e = (ovs_expr){ OVS_BLOB, .p=r->blob.base };
+					free((void*)r);
+					continue;
+				}
+				free((void*)r);
+				break;
+			case OVS_FUNCTION:
+				r->function.type->free(&r->function + 1);
+				if (atomic_load_explicit(&r->function.represented, memory_order_relaxed) == REPRESENTED) {
+					ovs_dealias(r->function.representation);
+				}
+				free((void*)r);
+				break;
+			case OVS_STRING:
+			case OVS_BIG_INTEGER:
+			case OVS_ARRAY:
+				free((void*)r);
+				break;
+			default:
+				break;
+		}
+
+		if (!next_pending(pending, &count, &e)) {
 			break;
-		case OVS_BIG_INTEGER:
-			break;
+		}
+	}
+
+	if (pending != stack) {
+		free(pending);
 	}
 }
 
@@ -606,6 +1530,7 @@ ovs_context* ovs_init() {
 
 	for (int i = 0; i < OVS_ROOT_TABLE_COUNT; i++) {
 		c->root_tables[i].trie = (bdtrie){ NULL, ovs_get_value, ovs_update_value, ovs_free_value };
+		c->root_tables[i].conses = NULL;
 
 		if (i == OVS_UNQUALIFIED) {
 			c->root_tables[i].qualifier = NULL;
@@ -628,81 +1553,420 @@ ovs_context* ovs_init() {
 void ovs_close(ovs_context* c) {
 	for (int i = 0; i < OVS_ROOT_TABLE_COUNT; i++) {
 		bdtrie_clear(&c->root_tables[i].trie);
+		ovs_table_hash_cons(&c->root_tables[i], false);
 	}
 	free(c);
 }
 
+ovs_expr_ref* list_ref(ovs_table* t, int32_t count) {
+	if (t->qualifier != NULL) {
+		ovs_ref(t->qualifier);
+	}
+
+	ovs_expr_ref* r = ref(offsetof(ovs_list_data, elements) + sizeof(ovs_expr) * count, 1);
+	r->list.table = t;
+	r->list.size = count;
+	r->list.tail = ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+	return r;
+}
+
 ovs_expr ovs_list(ovs_table* t, int32_t count, ovs_expr* e) {
-	ovs_expr l = ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
-	for (int i = count - 1; i >= 0; i--) {
-		ovs_expr prev = l;
-		l = ovs_cons(t, e[i], l);
-		ovs_dealias(prev);
+	if (count == 0) {
+		return ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
 	}
-	return l;
+	if (t->conses != NULL) {
+		ovs_expr l = ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+		for (int i = count - 1; i >= 0; i--) {
+			ovs_expr tail = l;
+			l = ovs_cons(t, e[i], tail);
+			ovs_dealias(tail);
+		}
+		return l;
+	}
+	ovs_expr_ref* r = list_ref(t, count);
+	for (int i = 0; i < count; i++) {
+		r->list.elements[i] = ovs_alias(e[i]);
+	}
+	return (ovs_expr){ OVS_LIST, 0, .p=r };
 }
 
 ovs_expr ovs_list_of(ovs_table* t, int32_t count, void** e, ovs_expr (*map)(const void* elem)) {
-	ovs_expr l = ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
-	for (int i = count - 1; i >= 0; i--) {
-		ovs_expr prev = l;
-		ovs_expr head = map(e[i]);
-		l = ovs_cons(t, head, l);
+	if (count == 0) {
+		return ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+	}
+	if (t->conses != NULL) {
+		ovs_expr l = ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+		for (int i = count - 1; i >= 0; i--) {
+			ovs_expr head = map(e[i]);
+			ovs_expr tail = l;
+			l = ovs_cons(t, head, tail);
+			ovs_dealias(head);
+			ovs_dealias(tail);
+		}
+		return l;
+	}
+	ovs_expr_ref* r = list_ref(t, count);
+	for (int i = 0; i < count; i++) {
+		r->list.elements[i] = map(e[i]);
+	}
+	return (ovs_expr){ OVS_LIST, 0, .p=r };
+}
+
+bool is_nil(ovs_expr e) {
+	return e.type == OVS_SYMBOL && e.p == ovs_root_symbol(OVS_DATA_NIL)->expr.p;
+}
+
+bool is_cell(ovs_table* t, ovs_expr e) {
+	if (is_pair(e)) {
+		return cell_qualifier(e) == t->qualifier;
+	}
+	return !ovs_is_atom(t, e);
+}
+
+/*
+ * Step to the tail of a list. Cons cells and contiguous lists are walked
+ * without taking references, other representations go through ovs_cdr, and *owned
+ * records whether the caller must release the result.
+ */
+ovs_expr list_next(ovs_expr e, bool* owned) {
+	ovs_expr tail;
+	if (is_pair(e)) {
+		tail = pair_cdr(e);
+		if (*owned) {
+			ovs_alias(tail);
+			ovs_dealias(e);
+		}
+	} else {
+		tail = ovs_cdr(e);
+		if (*owned) {
+			ovs_dealias(e);
+		}
+		*owned = true;
+	}
+	return tail;
+}
+
+int32_t ovs_list_length(ovs_table* t, ovs_expr l) {
+	int32_t count = 0;
+	bool owned = false;
+	while (!is_nil(l)) {
+		if (!is_cell(t, l)) {
+			count = -1;
+			break;
+		}
+		l = list_next(l, &owned);
+		count++;
+	}
+	if (owned) {
+		ovs_dealias(l);
+	}
+	return count;
+}
+
+int32_t ovs_delist_into(ovs_table* t, ovs_expr l, int32_t count, ovs_expr* e) {
+	int32_t index = 0;
+	bool owned = false;
+	while (!is_nil(l)) {
+		if (!is_cell(t, l)) {
+			for (int32_t i = 0; i < count && i < index; i++) {
+				ovs_dealias(e[i]);
+			}
+			index = -1;
+			break;
+		}
+		if (index < count) {
+			e[index] = ovs_car(l);
+		}
+		l = list_next(l, &owned);
+		index++;
+	}
+	if (owned) {
+		ovs_dealias(l);
+	}
+	return index;
+}
+
+int32_t ovs_delist(ovs_table* t, ovs_expr l, ovs_expr** e) {
+	int32_t count = ovs_list_length(t, l);
+	if (count <= 0) {
+		if (count == 0) {
+			*e = NULL;
+		}
+		return count;
+	}
+	*e = malloc(sizeof(ovs_expr) * count);
+	ovs_delist_into(t, l, count, *e);
+	return count;
+}
+
+int32_t ovs_delist_of(ovs_table* t, ovs_expr l, void*** e, void* (*map)(ovs_expr elem)) {
+	int32_t count = ovs_list_length(t, l);
+	if (count <= 0) {
+		if (count == 0) {
+			*e = NULL;
+		}
+		return count;
+	}
+	*e = malloc(sizeof(void*) * count);
+
+	int32_t index = 0;
+	bool owned = false;
+	while (index < count) {
+		ovs_expr head = ovs_car(l);
+		(*e)[index++] = map(head);
 		ovs_dealias(head);
-		ovs_dealias(prev);
+		l = list_next(l, &owned);
+	}
+	if (owned) {
+		ovs_dealias(l);
 	}
-	return l;
+	return count;
 }
 
-int32_t ovs_delist_recur(ovs_table* t, int32_t index, ovs_expr s, ovs_expr** elems) {
-	if (ovs_is_eq(s, ovs_root_symbol(OVS_DATA_NIL)->expr)) {
-		*elems = index == 0 ? NULL : malloc(sizeof(ovs_expr) * index);
-		return index;
+/*
+ * Vectors
+ */
+
+ovs_expr_ref* vector_ref(uint32_t count) {
+	ovs_expr_ref* r = ref(offsetof(ovs_vector_data, storage) + sizeof(ovs_expr) * count, 1);
+	r->vector.size = count;
+	r->vector.elements = r->vector.storage;
+	return r;
+}
+
+ovs_expr ovs_vector(int32_t count, ovs_expr* e) {
+	if (count == 0) {
+		return ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+	}
+	ovs_expr_ref* r = vector_ref(count);
+	for (int32_t i = 0; i < count; i++) {
+		r->vector.storage[i] = ovs_alias(e[i]);
 	}
+	return (ovs_expr){ OVS_VECTOR, 0, .p=r };
+}
 
-	if (ovs_is_atom(t, s)) {
-		return -1;
+int32_t ovs_vector_of_list(ovs_table* t, ovs_expr l, ovs_expr* v) {
+	int32_t count = ovs_list_length(t, l);
+	if (count < 0) {
+		return count;
 	}
+	if (count == 0) {
+		*v = ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+		return count;
+	}
+	ovs_expr_ref* r = vector_ref(count);
+	ovs_delist_into(t, l, count, r->vector.storage);
+	*v = (ovs_expr){ OVS_VECTOR, 0, .p=r };
+	return count;
+}
+
+bool ovs_is_vector(ovs_expr e) {
+	return e.type == OVS_VECTOR || is_nil(e);
+}
+
+uint32_t ovs_vector_length(ovs_expr v) {
+	if (v.type != OVS_VECTOR) {
+		return 0;
+	}
+	return v.p->vector.size - v.offset;
+}
 
-	ovs_expr tail = ovs_cdr(s);
-	int32_t size = ovs_delist_recur(t, index + 1, tail, elems);
-	ovs_dealias(tail);
+ovs_expr ovs_vector_index(ovs_expr v, uint32_t i) {
+	assert(i < ovs_vector_length(v));
+	return ovs_alias(v.p->vector.elements[v.offset + i]);
+}
+
+/*
+ * A slice which runs to the end of the vector is just a view at a later
+ * offset, anything shorter refers back to the elements of the original.
+ */
+ovs_expr ovs_vector_slice(ovs_expr v, uint32_t from, uint32_t to) {
+	uint32_t length = ovs_vector_length(v);
+	assert(from <= to && to <= length);
 
-	if (size >= 0) {
-		(*elems)[index] = ovs_car(s);
+	if (from == to) {
+		return ovs_alias(ovs_root_symbol(OVS_DATA_NIL)->expr);
+	}
+	if (to == length) {
+		return ovs_alias((ovs_expr){ OVS_VECTOR, v.offset + from, .p=v.p });
 	}
 
-	return size;
+	const ovs_expr_ref* base = v.p->vector.base != NULL ? v.p->vector.base : v.p;
+	ovs_expr_ref* r = ref(offsetof(ovs_vector_data, storage), 1);
+	r->vector.size = to - from;
+	r->vector.elements = v.p->vector.elements + v.offset + from;
+	r->vector.base = ovs_ref(base);
+	return (ovs_expr){ OVS_VECTOR, 0, .p=r };
 }
 
-int32_t ovs_delist(ovs_table* t, ovs_expr s, ovs_expr** elems) {
-	return ovs_delist_recur(t, 0, s, elems);
+/*
+ * Arrays
+ */
+
+ovs_expr ovs_array(ovs_array_kind kind, uint32_t size, void** elements) {
+	ovs_expr_ref* r = ref(offsetof(ovs_array_data, int64s) + sizeof(int64_t) * size, 1);
+	r->array.kind = kind;
+	r->array.size = size;
+	*elements = r->array.int64s;
+	return (ovs_expr){ OVS_ARRAY, .p=r };
 }
 
-int32_t ovs_delist_of_recur(ovs_table* t, int32_t index, ovs_expr s, void*** elems, void* (*map)(ovs_expr elem)) {
-	if (ovs_is_eq(s, ovs_root_symbol(OVS_DATA_NIL)->expr)) {
-		*elems = index == 0 ? NULL : malloc(sizeof(void*) * index);
-		return index;
+/*
+ * Integers are converted when building an array of doubles, anything
+ * else which is not an element of the given kind fails.
+ */
+int32_t ovs_array_of_list(ovs_table* t, ovs_array_kind kind, ovs_expr l, ovs_expr* a) {
+	int32_t count = ovs_list_length(t, l);
+	if (count < 0) {
+		return count;
+	}
+	void* elements;
+	*a = ovs_array(kind, count, &elements);
+
+	int32_t index = 0;
+	bool owned = false;
+	while (index < count) {
+		ovs_expr head = ovs_car(l);
+		if (kind == OVS_INT64_ARRAY && head.type == OVS_INTEGER) {
+			((int64_t*)elements)[index] = head.integer;
+		} else if (kind == OVS_DOUBLE_ARRAY && head.type == OVS_INTEGER) {
+			((double*)elements)[index] = head.integer;
+		} else if (kind == OVS_DOUBLE_ARRAY && head.type == OVS_FLOAT) {
+			((double*)elements)[index] = head.floating;
+		} else {
+			ovs_dealias(head);
+			ovs_dealias(*a);
+			count = -1;
+			break;
+		}
+		l = list_next(l, &owned);
+		index++;
 	}
+	if (owned) {
+		ovs_dealias(l);
+	}
+	return count;
+}
+
+bool ovs_is_array(ovs_expr e) {
+	return e.type == OVS_ARRAY;
+}
+
+uint32_t ovs_array_length(ovs_expr a) {
+	return a.p->array.size;
+}
 
-	if (ovs_is_atom(t, s)) {
-		return -1;
+ovs_expr ovs_array_index(ovs_expr a, uint32_t i) {
+	assert(i < a.p->array.size);
+	if (a.p->array.kind == OVS_INT64_ARRAY) {
+		return ovs_integer(a.p->array.int64s[i]);
+	} else {
+		return ovs_float(a.p->array.doubles[i]);
 	}
+}
 
-	ovs_expr tail = ovs_cdr(s);
-	int32_t size = ovs_delist_of_recur(t, index + 1, tail, elems, map);
-	ovs_dealias(tail);
+/*
+ * Blobs
+ */
 
-	if (size >= 0) {
-		ovs_expr e = ovs_car(s);
-		(*elems)[index] = map(e);
-		ovs_dealias(e);
+ovs_expr ovs_blob(uint64_t size, const uint8_t* bytes) {
+	ovs_expr_ref* r = ref(offsetof(ovs_blob_data, storage) + size, 1);
+	r->blob.size = size;
+	r->blob.bytes = r->blob.storage;
+	if (size > 0) {
+		memcpy(r->blob.storage, bytes, size);
+	}
+	return (ovs_expr){ OVS_BLOB, .p=r };
+}
+
+/*
+ * A blob over the contents of a file, mapped rather than read so the
+ * pages are only loaded as they are touched.
+ */
+bool ovs_blob_map_file(const char* path, ovs_expr* b) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
 	}
 
-	return size;
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return false;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		*b = ovs_blob(0, NULL);
+		return true;
+	}
+
+	void* bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (bytes == MAP_FAILED) {
+		return false;
+	}
+
+	ovs_expr_ref* r = ref(offsetof(ovs_blob_data, storage), 1);
+	r->blob.size = st.st_size;
+	r->blob.bytes = bytes;
+	r->blob.mapped = st.st_size;
+	*b = (ovs_expr){ OVS_BLOB, .p=r };
+	return true;
+}
+
+bool ovs_is_blob(ovs_expr e) {
+	return e.type == OVS_BLOB;
 }
 
-int32_t ovs_delist_of(ovs_table* t, ovs_expr s, void*** elems, void* (*map)(ovs_expr elem)) {
-	return ovs_delist_of_recur(t, 0, s, elems, map);
+uint64_t ovs_blob_length(ovs_expr b) {
+	return b.p->blob.size;
 }
 
+const uint8_t* ovs_blob_bytes(ovs_expr b) {
+	return b.p->blob.bytes;
+}
+
+ovs_expr ovs_blob_slice(ovs_expr b, uint64_t from, uint64_t to) {
+	assert(from <= to && to <= b.p->blob.size);
+
+	if (from == 0 && to == b.p->blob.size) {
+		return ovs_alias(b);
+	}
+
+	const ovs_expr_ref* base = b.p->blob.base != NULL ? b.p->blob.base : b.p;
+	ovs_expr_ref* r = ref(offsetof(ovs_blob_data, storage), 1);
+	r->blob.size = to - from;
+	r->blob.bytes = b.p->blob.bytes + from;
+	r->blob.base = ovs_ref(base);
+	return (ovs_expr){ OVS_BLOB, .p=r };
+}
+
+/*
+ * Decode the bytes as UTF-8, failing if they are malformed.
+ */
+bool ovs_blob_decode(ovs_expr b, ovs_expr* s) {
+	const ovs_blob_data* d = &b.p->blob;
+	if (d->size > INT32_MAX) {
+		return false;
+	}
+
+	UErrorCode error = U_ZERO_ERROR;
+	int32_t len;
+	u_strFromUTF8(NULL, 0, &len, (const char*)d->bytes, d->size, &error);
+	if (error != U_BUFFER_OVERFLOW_ERROR && U_FAILURE(error)) {
+		return false;
+	}
+
+	error = U_ZERO_ERROR;
+	if (len <= OVS_SHORT_STRING_MAX) {
+		UChar chars[OVS_SHORT_STRING_MAX + 1];
+		u_strFromUTF8(chars, len + 1, NULL, (const char*)d->bytes, d->size, &error);
+		*s = short_string(len, chars);
+		return true;
+	}
+
+	ovs_expr_ref* r = string_ref(len);
+	u_strFromUTF8(r->string.string, len + 1, NULL, (const char*)d->bytes, d->size, &error);
+	*s = (ovs_expr){ OVS_STRING, .p=r };
+	return true;
+}
@@ -0,0 +1,309 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/umachine.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OVS_TEXT_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+ * Kernels over UTF-16 code units, with a portable version of each and on
+ * x86-64 an AVX2 version selected at runtime. Both return n when they
+ * find nothing.
+ */
+typedef struct text_kernels {
+	// the first i at which p occurs in s, for 0 < m
+	uint32_t (*find_units)(const UChar* s, uint32_t n, const UChar* p, uint32_t m);
+	// the first i at which a and b differ
+	uint32_t (*mismatch_units)(const UChar* a, const UChar* b, uint32_t n);
+} text_kernels;
+
+/*
+ * Portable kernels
+ */
+
+uint32_t find_units(const UChar* s, uint32_t n, const UChar* p, uint32_t m) {
+	for (uint32_t i = 0; i + m <= n; i++) {
+		if (s[i] == p[0] && !memcmp(s + i + 1, p + 1, sizeof(UChar) * (m - 1))) {
+			return i;
+		}
+	}
+	return n;
+}
+
+uint32_t mismatch_units(const UChar* a, const UChar* b, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		if (a[i] != b[i]) {
+			return i;
+		}
+	}
+	return n;
+}
+
+static const text_kernels portable_text_kernels = {
+	find_units,
+	mismatch_units
+};
+
+#ifdef OVS_TEXT_AVX2
+
+/*
+ * AVX2 kernels, sixteen code units at a time with a portable tail
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+/*
+ * Candidate positions are those where both the first and the last unit
+ * of the pattern match, which rules out most of them before comparing
+ * the units in between.
+ */
+AVX2 uint32_t find_units_avx2(const UChar* s, uint32_t n, const UChar* p, uint32_t m) {
+	__m256i first = _mm256_set1_epi16(p[0]);
+	__m256i last = _mm256_set1_epi16(p[m - 1]);
+
+	uint32_t i = 0;
+	for (; m <= n && i + 16 <= n - m + 1; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(s + i + m - 1));
+		__m256i eq = _mm256_and_si256(_mm256_cmpeq_epi16(a, first), _mm256_cmpeq_epi16(b, last));
+		uint32_t mask = _mm256_movemask_epi8(eq) & 0x55555555;
+		while (mask != 0) {
+			uint32_t j = i + __builtin_ctz(mask) / 2;
+			if (m <= 2 || !memcmp(s + j + 1, p + 1, sizeof(UChar) * (m - 2))) {
+				return j;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return i + find_units(s + i, n - i, p, m);
+}
+
+AVX2 uint32_t mismatch_units_avx2(const UChar* a, const UChar* b, uint32_t n) {
+	uint32_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+		uint32_t mask = ~_mm256_movemask_epi8(_mm256_cmpeq_epi16(x, y));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask) / 2;
+		}
+	}
+	return i + mismatch_units(a + i, b + i, n - i);
+}
+
+static const text_kernels avx2_text_kernels = {
+	find_units_avx2,
+	mismatch_units_avx2
+};
+
+#endif
+
+static const text_kernels* _Atomic selected_text_kernels;
+
+const text_kernels* get_text_kernels() {
+	const text_kernels* k = atomic_load_explicit(&selected_text_kernels, memory_order_relaxed);
+	if (k == NULL) {
+		k = &portable_text_kernels;
+#ifdef OVS_TEXT_AVX2
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			k = &avx2_text_kernels;
+		}
+#endif
+		atomic_store_explicit(&selected_text_kernels, k, memory_order_relaxed);
+	}
+	return k;
+}
+
+/*
+ * String builder
+ */
+
+size_t builder_size(uint32_t capacity) {
+	return offsetof(ovs_expr_ref, string)
+		+ offsetof(ovs_string_data, string)
+		+ sizeof(UChar) * (capacity + 1);
+}
+
+void ovs_string_builder_init(ovs_string_builder* b) {
+	b->capacity = 0;
+	b->r = NULL;
+}
+
+void ovs_string_builder_append(ovs_string_builder* b, uint32_t l, const UChar* s) {
+	uint32_t length = b->r != NULL ? b->r->string.length : 0;
+	if (length + l > b->capacity) {
+		uint32_t capacity = b->capacity < 8 ? 16 : 2 * b->capacity;
+		if (capacity < length + l) {
+			capacity = length + l;
+		}
+		b->r = realloc(b->r, builder_size(capacity));
+		b->capacity = capacity;
+		if (length == 0) {
+			b->r->ref_count = ATOMIC_VAR_INIT(1);
+			b->r->hash = ATOMIC_VAR_INIT(0);
+		}
+	}
+	if (b->r != NULL) {
+		memcpy(b->r->string.string + length, s, sizeof(UChar) * l);
+		b->r->string.length = length + l;
+	}
+}
+
+void ovs_string_builder_append_string(ovs_string_builder* b, ovs_expr s) {
+	uint32_t length;
+	const UChar* chars = ovs_string_chars(&s, &length);
+	ovs_string_builder_append(b, length, chars);
+}
+
+/*
+ * The buffer of a builder becomes the storage of the string it built,
+ * unless that is short enough to be stored inline.
+ */
+ovs_expr ovs_string_builder_finish(ovs_string_builder* b) {
+	ovs_expr_ref* r = b->r;
+	b->r = NULL;
+	b->capacity = 0;
+
+	if (r == NULL) {
+		return ovs_string(0, u"");
+	}
+
+	uint32_t length = r->string.length;
+	if (length <= OVS_SHORT_STRING_MAX) {
+		ovs_expr e = ovs_string(length, r->string.string);
+		free(r);
+		return e;
+	}
+
+	r = realloc(r, builder_size(length));
+	r->string.string[length] = u'\0';
+	return (ovs_expr){ OVS_STRING, .p=r };
+}
+
+/*
+ * Strings
+ *
+ * Offsets into strings count UTF-16 code units.
+ */
+
+ovs_expr ovs_substring(ovs_expr s, uint32_t from, uint32_t to) {
+	uint32_t length;
+	const UChar* chars = ovs_string_chars(&s, &length);
+	assert(from <= to && to <= length);
+
+	if (from == 0 && to == length) {
+		return ovs_alias(s);
+	}
+	return ovs_string(to - from, (UChar*)chars + from);
+}
+
+bool ovs_string_find(ovs_expr s, ovs_expr pattern, uint32_t from, uint32_t* index) {
+	uint32_t n;
+	uint32_t m;
+	const UChar* chars = ovs_string_chars(&s, &n);
+	const UChar* p = ovs_string_chars(&pattern, &m);
+
+	if (from > n || m > n - from) {
+		return false;
+	}
+	if (m == 0) {
+		*index = from;
+		return true;
+	}
+
+	uint32_t i = get_text_kernels()->find_units(chars + from, n - from, p, m);
+	if (i == n - from) {
+		return false;
+	}
+	*index = from + i;
+	return true;
+}
+
+/*
+ * Whether the unit at i is part of a surrogate pair.
+ */
+bool is_paired_surrogate(const UChar* s, uint32_t i, uint32_t length) {
+	return (U16_IS_LEAD(s[i]) && i + 1 < length && U16_IS_TRAIL(s[i + 1]))
+		|| (U16_IS_TRAIL(s[i]) && i > 0 && U16_IS_LEAD(s[i - 1]));
+}
+
+/*
+ * Compare in code point order, which differs from the order of UTF-16
+ * code units only where a surrogate pair meets a unit above it. A lone
+ * surrogate stands for its own code point, below those units.
+ */
+int32_t ovs_string_compare(ovs_expr a, ovs_expr b) {
+	uint32_t la;
+	uint32_t lb;
+	const UChar* ca = ovs_string_chars(&a, &la);
+	const UChar* cb = ovs_string_chars(&b, &lb);
+
+	uint32_t n = la < lb ? la : lb;
+	uint32_t i = get_text_kernels()->mismatch_units(ca, cb, n);
+	if (i == n) {
+		return la < lb ? -1 : la > lb ? 1 : 0;
+	}
+
+	int32_t x = ca[i];
+	int32_t y = cb[i];
+	if (x >= 0xd800 && y >= 0xd800) {
+		x += is_paired_surrogate(ca, i, la) ? 0x10000 : 0;
+		y += is_paired_surrogate(cb, i, lb) ? 0x10000 : 0;
+	}
+	return x < y ? -1 : 1;
+}
+
+/*
+ * The pieces of s between occurrences of a non-empty separator.
+ */
+ovs_expr ovs_string_split(ovs_table* t, ovs_expr s, ovs_expr separator) {
+	uint32_t length;
+	uint32_t separator_length;
+	ovs_string_chars(&s, &length);
+	ovs_string_chars(&separator, &separator_length);
+	assert(separator_length > 0);
+
+	uint32_t capacity = 16;
+	uint32_t count = 0;
+	ovs_expr* pieces = malloc(sizeof(ovs_expr) * capacity);
+
+	uint32_t from = 0;
+	uint32_t index;
+	while (true) {
+		bool found = ovs_string_find(s, separator, from, &index);
+		if (count == capacity) {
+			capacity *= 2;
+			pieces = realloc(pieces, sizeof(ovs_expr) * capacity);
+		}
+		if (!found) {
+			pieces[count++] = ovs_substring(s, from, length);
+			break;
+		}
+		pieces[count++] = ovs_substring(s, from, index);
+		from = index + separator_length;
+	}
+
+	ovs_expr l = ovs_list(t, count, pieces);
+	for (uint32_t i = 0; i < count; i++) {
+		ovs_dealias(pieces[i]);
+	}
+	free(pieces);
+	return l;
+}
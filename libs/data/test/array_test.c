@@ -0,0 +1,207 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OVS_ARRAY_AVX2
+#endif
+
+/*
+ * The kernels of array.c, portable and AVX2, each of which is checked
+ * against the other.
+ */
+#define KERNELS(suffix) \
+	void add_int64##suffix(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n); \
+	void sub_int64##suffix(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n); \
+	void mul_int64##suffix(const int64_t* a, const int64_t* b, int64_t* r, uint32_t n); \
+	int64_t dot_int64##suffix(const int64_t* a, const int64_t* b, uint32_t n); \
+	int64_t sum_int64##suffix(const int64_t* a, uint32_t n); \
+	int64_t min_int64##suffix(const int64_t* a, uint32_t n); \
+	int64_t max_int64##suffix(const int64_t* a, uint32_t n); \
+	void prefix_sum_int64##suffix(const int64_t* a, int64_t* r, uint32_t n); \
+	void add_double##suffix(const double* a, const double* b, double* r, uint32_t n); \
+	void sub_double##suffix(const double* a, const double* b, double* r, uint32_t n); \
+	void mul_double##suffix(const double* a, const double* b, double* r, uint32_t n); \
+	double dot_double##suffix(const double* a, const double* b, uint32_t n); \
+	double sum_double##suffix(const double* a, uint32_t n); \
+	double min_double##suffix(const double* a, uint32_t n); \
+	double max_double##suffix(const double* a, uint32_t n); \
+	void prefix_sum_double##suffix(const double* a, double* r, uint32_t n);
+
+KERNELS()
+#ifdef OVS_ARRAY_AVX2
+KERNELS(_avx2)
+#endif
+
+#define MAX_LENGTH 67
+
+static ovs_context* context;
+static uint64_t seed;
+static int64_t ia[MAX_LENGTH];
+static int64_t ib[MAX_LENGTH];
+static double da[MAX_LENGTH];
+static double db[MAX_LENGTH];
+
+void setUp() {
+	context = ovs_init();
+	seed = 88172645463325252ull;
+}
+
+void tearDown() {
+	ovs_close(context);
+}
+
+uint64_t next_random() {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return seed;
+}
+
+/*
+ * Int64 elements over their whole range, so arithmetic wraps, and double
+ * elements which are small integers, so that sums are exact in any order.
+ */
+void fill_elements() {
+	for (int i = 0; i < MAX_LENGTH; i++) {
+		ia[i] = (int64_t)next_random();
+		ib[i] = (int64_t)next_random();
+		da[i] = (double)((int64_t)(next_random() % 2001) - 1000);
+		db[i] = (double)((int64_t)(next_random() % 2001) - 1000);
+	}
+}
+
+#ifdef OVS_ARRAY_AVX2
+
+/*
+ * Every length up to a few vectors, so each kernel runs with and without
+ * a tail, and with no full vector at all.
+ */
+void test_avx2_matches_portable() {
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2")) {
+		return;
+	}
+
+	int64_t ix[MAX_LENGTH];
+	int64_t iy[MAX_LENGTH];
+	double dx[MAX_LENGTH];
+	double dy[MAX_LENGTH];
+	for (uint32_t n = 0; n <= MAX_LENGTH; n++) {
+		fill_elements();
+
+		add_int64(ia, ib, ix, n);
+		add_int64_avx2(ia, ib, iy, n);
+		TEST_ASSERT_TRUE(!memcmp(ix, iy, sizeof(int64_t) * n));
+		sub_int64(ia, ib, ix, n);
+		sub_int64_avx2(ia, ib, iy, n);
+		TEST_ASSERT_TRUE(!memcmp(ix, iy, sizeof(int64_t) * n));
+		mul_int64(ia, ib, ix, n);
+		mul_int64_avx2(ia, ib, iy, n);
+		TEST_ASSERT_TRUE(!memcmp(ix, iy, sizeof(int64_t) * n));
+		prefix_sum_int64(ia, ix, n);
+		prefix_sum_int64_avx2(ia, iy, n);
+		TEST_ASSERT_TRUE(!memcmp(ix, iy, sizeof(int64_t) * n));
+		TEST_ASSERT_EQUAL_INT64(dot_int64(ia, ib, n), dot_int64_avx2(ia, ib, n));
+		TEST_ASSERT_EQUAL_INT64(sum_int64(ia, n), sum_int64_avx2(ia, n));
+
+		add_double(da, db, dx, n);
+		add_double_avx2(da, db, dy, n);
+		TEST_ASSERT_TRUE(!memcmp(dx, dy, sizeof(double) * n));
+		sub_double(da, db, dx, n);
+		sub_double_avx2(da, db, dy, n);
+		TEST_ASSERT_TRUE(!memcmp(dx, dy, sizeof(double) * n));
+		mul_double(da, db, dx, n);
+		mul_double_avx2(da, db, dy, n);
+		TEST_ASSERT_TRUE(!memcmp(dx, dy, sizeof(double) * n));
+		prefix_sum_double(da, dx, n);
+		prefix_sum_double_avx2(da, dy, n);
+		TEST_ASSERT_TRUE(!memcmp(dx, dy, sizeof(double) * n));
+		TEST_ASSERT_TRUE(dot_double(da, db, n) == dot_double_avx2(da, db, n));
+		TEST_ASSERT_TRUE(sum_double(da, n) == sum_double_avx2(da, n));
+
+		if (n > 0) {
+			TEST_ASSERT_EQUAL_INT64(min_int64(ia, n), min_int64_avx2(ia, n));
+			TEST_ASSERT_EQUAL_INT64(max_int64(ia, n), max_int64_avx2(ia, n));
+			TEST_ASSERT_TRUE(min_double(da, n) == min_double_avx2(da, n));
+			TEST_ASSERT_TRUE(max_double(da, n) == max_double_avx2(da, n));
+		}
+	}
+}
+
+#endif
+
+/*
+ * The extremes of int64 among other elements, at each position.
+ */
+void test_extremes() {
+	const int64_t elements[] = { 5, INT64_MIN, 7, INT64_MAX, -3, 0 };
+	int64_t expected_min = elements[0];
+	int64_t expected_max = elements[0];
+	for (uint32_t n = 1; n <= 6; n++) {
+		expected_min = elements[n - 1] < expected_min ? elements[n - 1] : expected_min;
+		expected_max = elements[n - 1] > expected_max ? elements[n - 1] : expected_max;
+
+		void* data;
+		ovs_expr a = ovs_array(OVS_INT64_ARRAY, n, &data);
+		memcpy(data, elements, sizeof(int64_t) * n);
+
+		ovs_expr min;
+		ovs_expr max;
+		TEST_ASSERT_TRUE(ovs_array_min(a, &min));
+		TEST_ASSERT_TRUE(ovs_array_max(a, &max));
+		TEST_ASSERT_EQUAL_INT64(expected_min, min.integer);
+		TEST_ASSERT_EQUAL_INT64(expected_max, max.integer);
+		ovs_dealias(a);
+	}
+}
+
+void test_empty_arrays() {
+	void* data;
+	ovs_expr ints = ovs_array(OVS_INT64_ARRAY, 0, &data);
+	ovs_expr doubles = ovs_array(OVS_DOUBLE_ARRAY, 0, &data);
+	ovs_expr r;
+
+	TEST_ASSERT_TRUE(!ovs_array_min(ints, &r));
+	TEST_ASSERT_TRUE(!ovs_array_max(ints, &r));
+	TEST_ASSERT_TRUE(!ovs_array_min(doubles, &r));
+	TEST_ASSERT_TRUE(!ovs_array_max(doubles, &r));
+
+	TEST_ASSERT_TRUE(ovs_array_sum(ints, &r));
+	TEST_ASSERT_EQUAL_INT64(0, r.integer);
+	TEST_ASSERT_TRUE(ovs_array_dot(doubles, doubles, &r));
+	TEST_ASSERT_TRUE(r.floating == 0);
+
+	TEST_ASSERT_TRUE(ovs_array_prefix_sum(ints, &r));
+	TEST_ASSERT_EQUAL_INT32(0, ovs_array_length(r));
+	ovs_dealias(r);
+
+	TEST_ASSERT_TRUE(!ovs_array_add(ints, doubles, &r));
+
+	ovs_dealias(doubles);
+	ovs_dealias(ints);
+}
+
+int main() {
+	UNITY_BEGIN();
+
+#ifdef OVS_ARRAY_AVX2
+	RUN_TEST(test_avx2_matches_portable);
+#endif
+	RUN_TEST(test_extremes);
+	RUN_TEST(test_empty_arrays);
+
+	return UNITY_END();
+}
@@ -0,0 +1,128 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/ucnv.h>
+#include <unicode/ustring.h>
+
+#include "c-ohvu/io/stringref.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+static ovs_context* context;
+
+void setUp() {
+	context = ovs_init();
+}
+
+void tearDown() {
+	ovs_close(context);
+}
+
+bool has_chars(ovs_expr s, const UChar* expected) {
+	uint32_t length;
+	const UChar* chars = ovs_string_chars(&s, &length);
+	return length == (uint32_t)u_strlen(expected) && !memcmp(chars, expected, sizeof(UChar) * length);
+}
+
+/*
+ * A slice of a slice shares the bytes of the first blob, and keeps them
+ * alive once that is gone.
+ */
+void test_slice() {
+	const char* text = "0123456789abcdef";
+	ovs_expr b = ovs_blob(16, (const uint8_t*)text);
+	ovs_expr s = ovs_blob_slice(b, 4, 14);
+	ovs_expr t = ovs_blob_slice(s, 2, 6);
+	ovs_dealias(s);
+	ovs_dealias(b);
+
+	TEST_ASSERT_EQUAL_INT64(4, ovs_blob_length(t));
+	TEST_ASSERT_TRUE(!memcmp("6789", ovs_blob_bytes(t), 4));
+
+	ovs_expr copy = ovs_blob(4, (const uint8_t*)"6789");
+	TEST_ASSERT_TRUE(ovs_is_eq(copy, t));
+	TEST_ASSERT_EQUAL(ovs_hash(copy), ovs_hash(t));
+
+	ovs_expr whole = ovs_blob_slice(t, 0, 4);
+	TEST_ASSERT_TRUE(whole.p == t.p);
+	ovs_expr empty = ovs_blob_slice(t, 2, 2);
+	TEST_ASSERT_EQUAL_INT64(0, ovs_blob_length(empty));
+	TEST_ASSERT_TRUE(!ovs_is_eq(empty, t));
+
+	ovs_dealias(empty);
+	ovs_dealias(whole);
+	ovs_dealias(copy);
+	ovs_dealias(t);
+}
+
+void test_decode() {
+	const char* text = "r\xc3\xa9sum\xc3\xa9 \xf0\x9d\x84\x9e";
+	ovs_expr b = ovs_blob(strlen(text), (const uint8_t*)text);
+	ovs_expr s;
+	TEST_ASSERT_TRUE(ovs_blob_decode(b, &s));
+	TEST_ASSERT_TRUE(has_chars(s, u"résumé 𝄞"));
+	ovs_dealias(s);
+
+	// cut part way through the last character
+	ovs_expr cut = ovs_blob_slice(b, 0, strlen(text) - 1);
+	TEST_ASSERT_TRUE(!ovs_blob_decode(cut, &s));
+	ovs_dealias(cut);
+	ovs_dealias(b);
+
+	char long_text[200];
+	memset(long_text, 'x', sizeof(long_text));
+	b = ovs_blob(sizeof(long_text), (const uint8_t*)long_text);
+	TEST_ASSERT_TRUE(ovs_blob_decode(b, &s));
+	TEST_ASSERT_EQUAL(OVS_STRING, s.type);
+	uint32_t length;
+	ovs_string_chars(&s, &length);
+	TEST_ASSERT_EQUAL_INT32(sizeof(long_text), length);
+	ovs_dealias(s);
+	ovs_dealias(b);
+
+	b = ovs_blob(0, NULL);
+	TEST_ASSERT_TRUE(ovs_blob_decode(b, &s));
+	TEST_ASSERT_TRUE(has_chars(s, u""));
+	ovs_dealias(s);
+	ovs_dealias(b);
+}
+
+void test_map_file() {
+	char path[] = "/tmp/blob-test-XXXXXX";
+	int fd = mkstemp(path);
+	TEST_ASSERT_TRUE(write(fd, "mapped bytes", 12) == 12);
+	close(fd);
+
+	ovs_expr b;
+	TEST_ASSERT_TRUE(ovs_blob_map_file(path, &b));
+	unlink(path);
+	ovs_expr s = ovs_blob_slice(b, 7, 12);
+	ovs_dealias(b);
+
+	ovs_expr decoded;
+	TEST_ASSERT_TRUE(ovs_blob_decode(s, &decoded));
+	TEST_ASSERT_TRUE(has_chars(decoded, u"bytes"));
+	ovs_dealias(decoded);
+	ovs_dealias(s);
+
+	TEST_ASSERT_TRUE(!ovs_blob_map_file(path, &b));
+}
+
+int main() {
+	UNITY_BEGIN();
+
+	RUN_TEST(test_slice);
+	RUN_TEST(test_decode);
+	RUN_TEST(test_map_file);
+
+	return UNITY_END();
+}
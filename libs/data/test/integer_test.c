@@ -0,0 +1,227 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/ucnv.h>
+#include <unicode/ustring.h>
+
+#include "c-ohvu/io/stringref.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+// as in integer.c, and the multiplication routines it uses internally
+#define KARATSUBA_THRESHOLD 32
+
+void mul_schoolbook(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn, uint32_t* r);
+void mul_limbs(const uint32_t* a, uint32_t an, const uint32_t* b, uint32_t bn, uint32_t* r);
+
+static ovs_context* context;
+static uint64_t seed;
+
+void setUp() {
+	context = ovs_init();
+	seed = 88172645463325252ull;
+}
+
+void tearDown() {
+	ovs_close(context);
+}
+
+uint32_t next_random() {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return (uint32_t)seed;
+}
+
+ovs_expr parse(const char* s) {
+	UChar text[256];
+	u_uastrcpy(text, s);
+	ovs_expr e;
+	TEST_ASSERT_TRUE(ovs_parse_integer(u_strlen(text), text, &e));
+	return e;
+}
+
+bool has_text(ovs_expr e, const char* s) {
+	UChar expected[256];
+	u_uastrcpy(expected, s);
+	uint32_t length;
+	UChar* text = ovs_integer_text(e, &length);
+	bool same = length == (uint32_t)u_strlen(expected) && !u_strcmp(text, expected);
+	free(text);
+	return same;
+}
+
+void test_promote_and_demote_at_int64_bounds() {
+	ovs_expr max = ovs_integer(INT64_MAX);
+	ovs_expr min = ovs_integer(INT64_MIN);
+	ovs_expr one = ovs_integer(1);
+	ovs_expr minus_one = ovs_integer(-1);
+
+	ovs_expr above = ovs_integer_add(max, one);
+	TEST_ASSERT_EQUAL(OVS_BIG_INTEGER, above.type);
+	TEST_ASSERT_TRUE(has_text(above, "9223372036854775808"));
+	ovs_expr back = ovs_integer_sub(above, one);
+	TEST_ASSERT_EQUAL(OVS_INTEGER, back.type);
+	TEST_ASSERT_EQUAL_INT64(INT64_MAX, back.integer);
+
+	ovs_expr below = ovs_integer_sub(min, one);
+	TEST_ASSERT_EQUAL(OVS_BIG_INTEGER, below.type);
+	TEST_ASSERT_TRUE(has_text(below, "-9223372036854775809"));
+	back = ovs_integer_add(below, one);
+	TEST_ASSERT_EQUAL(OVS_INTEGER, back.type);
+	TEST_ASSERT_EQUAL_INT64(INT64_MIN, back.integer);
+
+	ovs_expr negated = ovs_integer_mul(min, minus_one);
+	TEST_ASSERT_EQUAL(OVS_BIG_INTEGER, negated.type);
+	TEST_ASSERT_TRUE(ovs_is_eq(above, negated));
+	TEST_ASSERT_EQUAL_INT32(0, ovs_integer_compare(above, negated));
+	TEST_ASSERT_EQUAL_INT32(1, ovs_integer_compare(above, max));
+	TEST_ASSERT_EQUAL_INT32(-1, ovs_integer_compare(below, min));
+
+	ovs_expr q;
+	ovs_expr r;
+	TEST_ASSERT_TRUE(ovs_integer_divmod(min, minus_one, &q, &r));
+	TEST_ASSERT_TRUE(ovs_is_eq(above, q));
+	TEST_ASSERT_EQUAL(OVS_INTEGER, r.type);
+	TEST_ASSERT_EQUAL_INT64(0, r.integer);
+	ovs_dealias(q);
+	ovs_dealias(r);
+
+	ovs_expr square = ovs_integer_mul(max, max);
+	TEST_ASSERT_TRUE(ovs_integer_divmod(square, max, &q, &r));
+	TEST_ASSERT_EQUAL(OVS_INTEGER, q.type);
+	TEST_ASSERT_EQUAL_INT64(INT64_MAX, q.integer);
+	TEST_ASSERT_EQUAL_INT64(0, r.integer);
+
+	ovs_dealias(square);
+	ovs_dealias(negated);
+	ovs_dealias(below);
+	ovs_dealias(above);
+}
+
+/*
+ * Operand sizes either side of the threshold, balanced and not, checked
+ * limb for limb against the direct method.
+ */
+void test_karatsuba_matches_schoolbook() {
+	const uint32_t sizes[][2] = {
+		{ KARATSUBA_THRESHOLD - 1, KARATSUBA_THRESHOLD - 1 },
+		{ KARATSUBA_THRESHOLD, KARATSUBA_THRESHOLD },
+		{ KARATSUBA_THRESHOLD + 1, KARATSUBA_THRESHOLD },
+		{ 3 * KARATSUBA_THRESHOLD, 2 * KARATSUBA_THRESHOLD + 5 },
+		{ 5 * KARATSUBA_THRESHOLD + 3, KARATSUBA_THRESHOLD },
+		{ KARATSUBA_THRESHOLD, 7 * KARATSUBA_THRESHOLD + 1 },
+		{ 500, 499 }
+	};
+	for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+		uint32_t an = sizes[k][0];
+		uint32_t bn = sizes[k][1];
+		uint32_t* a = malloc(sizeof(uint32_t) * (an + bn));
+		uint32_t* b = malloc(sizeof(uint32_t) * bn);
+		uint32_t* expected = malloc(sizeof(uint32_t) * (an + bn));
+		uint32_t* r = malloc(sizeof(uint32_t) * (an + bn));
+		for (uint32_t i = 0; i < an; i++) {
+			a[i] = k % 2 ? next_random() : UINT32_MAX;
+		}
+		for (uint32_t i = 0; i < bn; i++) {
+			b[i] = k % 2 ? next_random() : UINT32_MAX;
+		}
+
+		mul_schoolbook(a, an, b, bn, expected);
+		mul_limbs(a, an, b, bn, r);
+		TEST_ASSERT_TRUE(!memcmp(expected, r, sizeof(uint32_t) * (an + bn)));
+
+		free(r);
+		free(expected);
+		free(b);
+		free(a);
+	}
+}
+
+/*
+ * Division truncates toward zero and the remainder takes the sign of the
+ * dividend, for small and big operands alike.
+ */
+void test_divmod_signs() {
+	const char* dividends[] = { "7", "-7", "123456789012345678901234567890", "-123456789012345678901234567890" };
+	const char* divisors[] = { "2", "-2", "98765432109876543210", "-98765432109876543210" };
+
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			ovs_expr a = parse(dividends[i]);
+			ovs_expr b = parse(divisors[j]);
+			ovs_expr q;
+			ovs_expr r;
+			TEST_ASSERT_TRUE(ovs_integer_divmod(a, b, &q, &r));
+
+			ovs_expr product = ovs_integer_mul(q, b);
+			ovs_expr sum = ovs_integer_add(product, r);
+			TEST_ASSERT_TRUE(ovs_is_eq(a, sum));
+
+			ovs_expr zero = ovs_integer(0);
+			int32_t sign = ovs_integer_compare(r, zero);
+			TEST_ASSERT_TRUE(sign == 0 || sign == ovs_integer_compare(a, zero));
+			int32_t quotient_sign = ovs_integer_compare(q, zero);
+			TEST_ASSERT_TRUE(quotient_sign == 0 || (quotient_sign < 0) == (i % 2 != j % 2));
+
+			ovs_dealias(sum);
+			ovs_dealias(product);
+			ovs_dealias(r);
+			ovs_dealias(q);
+			ovs_dealias(b);
+			ovs_dealias(a);
+		}
+	}
+
+	ovs_expr q;
+	ovs_expr r;
+	ovs_expr big = parse("123456789012345678901234567890");
+	TEST_ASSERT_TRUE(!ovs_integer_divmod(big, ovs_integer(0), &q, &r));
+	TEST_ASSERT_TRUE(!ovs_integer_divmod(ovs_integer(1), ovs_integer(0), &q, &r));
+	ovs_dealias(big);
+}
+
+void test_parse_and_text_round_trip() {
+	const char* texts[] = {
+		"0",
+		"-1",
+		"9223372036854775807",
+		"9223372036854775808",
+		"-9223372036854775808",
+		"-9223372036854775809",
+		"18446744073709551616",
+		"1000000000000000000000000000000000000",
+		"-123456789012345678901234567890123456789012345678901234567890"
+	};
+	for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+		ovs_expr e = parse(texts[i]);
+		TEST_ASSERT_TRUE(has_text(e, texts[i]));
+		ovs_dealias(e);
+	}
+
+	const char* invalid[] = { "", "-", "12a", "--1", "1-" };
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		UChar text[16];
+		u_uastrcpy(text, invalid[i]);
+		ovs_expr e;
+		TEST_ASSERT_TRUE(!ovs_parse_integer(u_strlen(text), text, &e));
+	}
+}
+
+int main() {
+	UNITY_BEGIN();
+
+	RUN_TEST(test_promote_and_demote_at_int64_bounds);
+	RUN_TEST(test_karatsuba_matches_schoolbook);
+	RUN_TEST(test_divmod_signs);
+	RUN_TEST(test_parse_and_text_round_trip);
+
+	return UNITY_END();
+}
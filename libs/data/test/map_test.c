@@ -0,0 +1,208 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#define KEY_COUNT 20000
+
+static ovs_context* context;
+
+void setUp() {
+	context = ovs_init();
+}
+
+void tearDown() {
+	ovs_close(context);
+}
+
+ovs_expr insert(ovs_expr m, ovs_expr key, ovs_expr value) {
+	ovs_expr n = ovs_map_insert(m, key, value);
+	ovs_dealias(m);
+	return n;
+}
+
+ovs_expr remove_key(ovs_expr m, ovs_expr key) {
+	ovs_expr n = ovs_map_remove(m, key);
+	ovs_dealias(m);
+	return n;
+}
+
+int64_t key_at(int32_t i) {
+	return i * 7919LL;
+}
+
+typedef struct hashed_key {
+	uint32_t hash;
+	int64_t key;
+} hashed_key;
+
+int compare_hashed_keys(const void* a, const void* b) {
+	uint32_t x = ((const hashed_key*)a)->hash;
+	uint32_t y = ((const hashed_key*)b)->hash;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Find pairs of integer keys whose hashes are the same, which the map
+ * keeps in collision nodes.
+ */
+int32_t find_collisions(int64_t* keys, int32_t pairs) {
+	const int32_t count = 400000;
+	hashed_key* h = malloc(sizeof(hashed_key) * count);
+	for (int32_t i = 0; i < count; i++) {
+		h[i] = (hashed_key){ ovs_hash(ovs_integer(i)), i };
+	}
+	qsort(h, count, sizeof(hashed_key), compare_hashed_keys);
+
+	int32_t found = 0;
+	for (int32_t i = 1; i < count && found < pairs; i++) {
+		if (h[i].hash == h[i - 1].hash) {
+			keys[2 * found] = h[i - 1].key;
+			keys[2 * found + 1] = h[i].key;
+			found++;
+			i++;
+		}
+	}
+	free(h);
+	return found;
+}
+
+void test_insert_lookup_remove() {
+	ovs_expr m = ovs_map();
+	for (int32_t i = 0; i < KEY_COUNT; i++) {
+		m = insert(m, ovs_integer(key_at(i)), ovs_integer(i));
+	}
+	TEST_ASSERT_EQUAL_INT32(KEY_COUNT, ovs_map_count(m));
+
+	ovs_expr before = ovs_alias(m);
+	for (int32_t i = 0; i < KEY_COUNT; i += 2) {
+		m = remove_key(m, ovs_integer(key_at(i)));
+	}
+	TEST_ASSERT_EQUAL_INT32(KEY_COUNT / 2, ovs_map_count(m));
+	TEST_ASSERT_EQUAL_INT32(KEY_COUNT, ovs_map_count(before));
+
+	int32_t wrong = 0;
+	for (int32_t i = 0; i < KEY_COUNT; i++) {
+		ovs_expr value;
+		bool found = ovs_map_lookup(m, ovs_integer(key_at(i)), &value);
+		wrong += found != (i % 2 == 1) || (found && value.integer != i);
+		wrong += !ovs_map_lookup(before, ovs_integer(key_at(i)), &value) || value.integer != i;
+	}
+	TEST_ASSERT_EQUAL_INT32(0, wrong);
+
+	ovs_expr value;
+	TEST_ASSERT_TRUE(!ovs_map_lookup(m, ovs_integer(1), &value));
+	ovs_expr same = ovs_map_remove(m, ovs_integer(1));
+	TEST_ASSERT_TRUE(same.p == m.p);
+	ovs_dealias(same);
+
+	m = insert(m, ovs_integer(key_at(1)), ovs_integer(-1));
+	TEST_ASSERT_EQUAL_INT32(KEY_COUNT / 2, ovs_map_count(m));
+	TEST_ASSERT_TRUE(ovs_map_lookup(m, ovs_integer(key_at(1)), &value));
+	TEST_ASSERT_EQUAL_INT64(-1, value.integer);
+
+	int64_t sum = 0;
+	int32_t visited = 0;
+	ovs_map_iterator it;
+	ovs_map_iterate(before, &it);
+	ovs_expr key;
+	while (ovs_map_next(&it, &key, &value)) {
+		sum += value.integer;
+		visited++;
+	}
+	TEST_ASSERT_EQUAL_INT32(KEY_COUNT, visited);
+	TEST_ASSERT_EQUAL_INT64((int64_t)KEY_COUNT * (KEY_COUNT - 1) / 2, sum);
+
+	ovs_dealias(before);
+	ovs_dealias(m);
+}
+
+/*
+ * Maps of the same entries are equal and hash the same whatever order
+ * they were inserted or removed in, including where keys collide.
+ */
+void test_order_independence() {
+	int64_t collisions[8];
+	int32_t pairs = find_collisions(collisions, 4);
+	TEST_ASSERT_TRUE(pairs > 0);
+
+	int32_t count = 1000 + 2 * pairs;
+	int64_t* keys = malloc(sizeof(int64_t) * count);
+	for (int32_t i = 0; i < 1000; i++) {
+		keys[i] = -key_at(i) - 1;
+	}
+	memcpy(keys + 1000, collisions, sizeof(int64_t) * 2 * pairs);
+
+	ovs_expr forward = ovs_map();
+	ovs_expr backward = ovs_map();
+	ovs_expr shuffled = ovs_map();
+	for (int32_t i = 0; i < count; i++) {
+		forward = insert(forward, ovs_integer(keys[i]), ovs_integer(keys[i] * 3));
+		backward = insert(backward, ovs_integer(keys[count - 1 - i]), ovs_integer(keys[count - 1 - i] * 3));
+		int32_t j = (int32_t)((i * 7919LL) % count);
+		shuffled = insert(shuffled, ovs_integer(keys[j]), ovs_integer(keys[j] * 3));
+	}
+	TEST_ASSERT_EQUAL_INT32(count, ovs_map_count(forward));
+	TEST_ASSERT_EQUAL_INT32(count, ovs_map_count(shuffled));
+	TEST_ASSERT_TRUE(ovs_is_eq(forward, backward));
+	TEST_ASSERT_TRUE(ovs_is_eq(forward, shuffled));
+	TEST_ASSERT_EQUAL(ovs_hash(forward), ovs_hash(backward));
+	TEST_ASSERT_EQUAL(ovs_hash(forward), ovs_hash(shuffled));
+
+	for (int32_t i = 0; i < 2 * pairs; i++) {
+		ovs_expr value;
+		TEST_ASSERT_TRUE(ovs_map_lookup(backward, ovs_integer(collisions[i]), &value));
+		TEST_ASSERT_EQUAL_INT64(collisions[i] * 3, value.integer);
+	}
+
+	// one of each colliding pair removed, in a different order
+	for (int32_t i = 0; i < pairs; i++) {
+		forward = remove_key(forward, ovs_integer(collisions[2 * i]));
+		backward = remove_key(backward, ovs_integer(collisions[2 * (pairs - 1 - i)]));
+	}
+	TEST_ASSERT_TRUE(ovs_is_eq(forward, backward));
+	TEST_ASSERT_EQUAL(ovs_hash(forward), ovs_hash(backward));
+	TEST_ASSERT_TRUE(!ovs_is_eq(forward, shuffled));
+
+	ovs_expr value;
+	TEST_ASSERT_TRUE(!ovs_map_lookup(forward, ovs_integer(collisions[0]), &value));
+	TEST_ASSERT_TRUE(ovs_map_lookup(forward, ovs_integer(collisions[1]), &value));
+
+	ovs_expr changed = ovs_map_insert(shuffled, ovs_integer(collisions[1]), ovs_integer(0));
+	TEST_ASSERT_TRUE(!ovs_is_eq(changed, shuffled));
+	ovs_dealias(changed);
+
+	for (int32_t i = 0; i < count; i++) {
+		shuffled = remove_key(shuffled, ovs_integer(keys[i]));
+	}
+	ovs_expr empty = ovs_map();
+	TEST_ASSERT_EQUAL_INT32(0, ovs_map_count(shuffled));
+	TEST_ASSERT_TRUE(ovs_is_eq(empty, shuffled));
+	TEST_ASSERT_EQUAL(ovs_hash(empty), ovs_hash(shuffled));
+
+	ovs_dealias(empty);
+	ovs_dealias(shuffled);
+	ovs_dealias(backward);
+	ovs_dealias(forward);
+	free(keys);
+}
+
+int main() {
+	UNITY_BEGIN();
+
+	RUN_TEST(test_insert_lookup_remove);
+	RUN_TEST(test_order_independence);
+
+	return UNITY_END();
+}
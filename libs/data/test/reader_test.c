@@ -0,0 +1,327 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/ustdio.h>
+
+#include "c-ohvu/io/stringref.h"
+#include "c-ohvu/io/stream.h"
+#include "c-ohvu/io/scanner.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+#include "c-ohvu/data/reader.h"
+
+static ovs_context* context;
+static ovio_stream* stream;
+static ovio_scanner* scanner;
+static ovda_reader* reader;
+
+void setUp() {
+	context = ovs_init();
+	stream = NULL;
+}
+
+void tearDown() {
+	if (stream != NULL) {
+		ovda_close_reader(reader);
+		ovio_close_scanner(scanner);
+		ovio_close_stream(stream);
+	}
+	ovs_close(context);
+}
+
+void open_reader(const char* s, int64_t length) {
+	stream = ovio_open_nstring_stream(s, length);
+	scanner = ovio_open_scanner(stream);
+	reader = ovda_open_reader(scanner, context);
+}
+
+void test_read_long_list() {
+	const int32_t count = 3000000;
+	char* s = malloc(12 * count);
+	int64_t length = 0;
+	s[length++] = '(';
+	for (int32_t i = 0; i < count; i++) {
+		length += sprintf(s + length, "%d ", i);
+	}
+	s[length++] = ')';
+
+	open_reader(s, length);
+	ovs_expr e;
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read(reader, &e));
+
+	ovs_table* t = &context->root_tables[OVS_UNQUALIFIED];
+	ovs_expr* elements;
+	TEST_ASSERT_EQUAL_INT32(count, ovs_delist(t, e, &elements));
+	TEST_ASSERT_EQUAL_INT64(0, elements[0].integer);
+	TEST_ASSERT_EQUAL_INT64(count - 1, elements[count - 1].integer);
+
+	for (int32_t i = 0; i < count; i++) {
+		ovs_dealias(elements[i]);
+	}
+	free(elements);
+	ovs_dealias(e);
+	free(s);
+}
+
+void test_read_deep_nesting() {
+	const int32_t depth = 1000000;
+	char* s = malloc(2 * depth);
+	memset(s, '(', depth);
+	memset(s + depth, ')', depth);
+
+	open_reader(s, 2 * depth);
+	ovs_expr e;
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read(reader, &e));
+	TEST_ASSERT_EQUAL_INT32(0, ovda_cursor_depth(reader));
+
+	ovs_dealias(e);
+	free(s);
+}
+
+void test_read_unclosed_list() {
+	const char* s = "(a (b c) (d";
+	open_reader(s, strlen(s));
+	ovs_expr e;
+	TEST_ASSERT_EQUAL(OVDA_INVALID, ovda_read(reader, &e));
+	TEST_ASSERT_EQUAL_INT32(0, ovda_cursor_depth(reader));
+}
+
+void test_step_in_and_out() {
+	const char* s = "(1 2 (3 4) . 5) 6";
+	open_reader(s, strlen(s));
+	ovs_expr e;
+
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read_step_in(reader));
+	TEST_ASSERT_EQUAL_INT32(1, ovda_cursor_depth(reader));
+
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read(reader, &e));
+	TEST_ASSERT_EQUAL_INT64(1, e.integer);
+	TEST_ASSERT_EQUAL_INT64(1, ovda_cursor_position(reader, 0));
+
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read_step_out(reader, &e));
+	TEST_ASSERT_EQUAL_INT32(0, ovda_cursor_depth(reader));
+	TEST_ASSERT_EQUAL_INT64(1, ovda_cursor_position(reader, 0));
+
+	ovs_table* t = &context->root_tables[OVS_UNQUALIFIED];
+	ovs_expr inner[] = { ovs_integer(3), ovs_integer(4) };
+	ovs_expr l = ovs_list(t, 2, inner);
+	ovs_expr dotted = ovs_cons(t, l, ovs_integer(5));
+	ovs_expr expected = ovs_cons(t, ovs_integer(2), dotted);
+	TEST_ASSERT_TRUE(ovs_is_eq(expected, e));
+	ovs_dealias(expected);
+	ovs_dealias(dotted);
+	ovs_dealias(l);
+	ovs_dealias(e);
+
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read(reader, &e));
+	TEST_ASSERT_EQUAL_INT64(6, e.integer);
+	TEST_ASSERT_EQUAL_INT64(2, ovda_cursor_position(reader, 0));
+}
+
+void test_read_empty_string() {
+	const char* s = "\"\" \"a\"";
+	open_reader(s, strlen(s));
+	ovs_table* t = &context->root_tables[OVS_UNQUALIFIED];
+	ovs_expr e;
+
+	const UChar* expected[] = { u"", u"a" };
+	for (int i = 0; i < 2; i++) {
+		TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read(reader, &e));
+		ovs_expr quoted[2];
+		TEST_ASSERT_EQUAL_INT32(2, ovs_delist_into(t, e, 2, quoted));
+		uint32_t length;
+		const UChar* chars = ovs_string_chars(&quoted[1], &length);
+		TEST_ASSERT_EQUAL_INT32(i, length);
+		TEST_ASSERT_TRUE(!memcmp(expected[i], chars, sizeof(UChar) * length));
+		ovs_dealias(quoted[1]);
+		ovs_dealias(quoted[0]);
+		ovs_dealias(e);
+	}
+}
+
+/*
+ * Feed a byte at a time, splitting multibyte characters, and check that
+ * the expressions come out the same as when read from a stream.
+ */
+void test_feed_bytes() {
+	const char* s = "(a \"résumé\" . 12) ; a comment\n'(x 𝄞 y)\n(1 (2 (3)) \"\") last";
+	int64_t length = strlen(s);
+	open_reader(s, length);
+	ovda_reader* push = ovda_open_push_reader(context);
+
+	ovs_expr expected;
+	ovs_expr e;
+	int32_t count = 0;
+	int64_t fed = 0;
+	while (ovda_read(reader, &expected) == OVDA_SUCCESS) {
+		ovda_result res = ovda_read(push, &e);
+		while (res == OVDA_NEED_INPUT) {
+			if (fed < length) {
+				ovio_block b = { OVIO_UTF8, .utf8_start=(const uint8_t*)s + fed, .utf8_end=(const uint8_t*)s + fed + 1 };
+				fed++;
+				res = ovda_feed(push, &b, &e);
+			} else {
+				res = ovda_feed(push, NULL, &e);
+			}
+		}
+		TEST_ASSERT_EQUAL(OVDA_SUCCESS, res);
+		TEST_ASSERT_TRUE(ovs_is_eq(expected, e));
+		ovs_dealias(expected);
+		ovs_dealias(e);
+		count++;
+	}
+
+	TEST_ASSERT_EQUAL_INT32(4, count);
+	TEST_ASSERT_EQUAL(OVDA_INVALID, ovda_feed(push, NULL, &e));
+	ovda_close_reader(push);
+}
+
+void test_feed_unfinished() {
+	const char* s = "(a (b";
+	ovda_reader* push = ovda_open_push_reader(context);
+	ovio_block b = { OVIO_UTF8, .utf8_start=(const uint8_t*)s, .utf8_end=(const uint8_t*)s + strlen(s) };
+
+	ovs_expr e;
+	TEST_ASSERT_EQUAL(OVDA_NEED_INPUT, ovda_feed(push, &b, &e));
+	TEST_ASSERT_EQUAL_INT32(2, ovda_cursor_depth(push));
+	TEST_ASSERT_EQUAL(OVDA_INVALID, ovda_feed(push, NULL, &e));
+	TEST_ASSERT_EQUAL_INT32(0, ovda_cursor_depth(push));
+	ovda_close_reader(push);
+}
+
+/*
+ * A string, comment and name each spanning several small blocks, which
+ * must not each be scanned again from their start whenever a block is
+ * fed. Names are kept within what the symbol table can hold.
+ */
+void test_feed_long_tokens() {
+	const int64_t size = 4 << 20;
+	const int64_t block = 4096;
+	char* s = malloc(2 * size + 6016);
+	int64_t length = 0;
+	s[length++] = '(';
+	s[length++] = '"';
+	memset(s + length, 'x', size);
+	length += size;
+	s[length++] = '"';
+	s[length++] = ';';
+	memset(s + length, ' ', size);
+	length += size;
+	s[length++] = '\n';
+	memset(s + length, 'y', 6000);
+	length += 6000;
+	s[length++] = ')';
+
+	ovda_reader* push = ovda_open_push_reader(context);
+	ovs_expr e;
+	ovda_result res = OVDA_NEED_INPUT;
+	for (int64_t fed = 0; fed < length && res == OVDA_NEED_INPUT; fed += block) {
+		int64_t end = fed + block < length ? fed + block : length;
+		ovio_block b = { OVIO_UTF8, .utf8_start=(const uint8_t*)s + fed, .utf8_end=(const uint8_t*)s + end };
+		res = ovda_feed(push, &b, &e);
+	}
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, res);
+
+	open_reader(s, length);
+	ovs_expr expected;
+	TEST_ASSERT_EQUAL(OVDA_SUCCESS, ovda_read(reader, &expected));
+	TEST_ASSERT_TRUE(ovs_is_eq(expected, e));
+
+	ovs_dealias(expected);
+	ovs_dealias(e);
+	ovda_close_reader(push);
+	free(s);
+}
+
+/*
+ * The indexed reader should read the same first expression as a reader
+ * over a stream of the same input.
+ */
+void check_indexed(const char* s, int64_t length) {
+	open_reader(s, length);
+	ovs_expr expected;
+	ovda_result expected_result = ovda_read(reader, &expected);
+	ovda_close_reader(reader);
+	ovio_close_scanner(scanner);
+	ovio_close_stream(stream);
+	stream = NULL;
+
+	ovs_expr e;
+	ovda_result result = ovda_read_indexed(context, s, length, &e);
+	TEST_ASSERT_EQUAL(expected_result, result);
+	if (expected_result == OVDA_SUCCESS && result == OVDA_SUCCESS) {
+		TEST_ASSERT_TRUE(ovs_is_eq(expected, e));
+	}
+	if (expected_result == OVDA_SUCCESS) {
+		ovs_dealias(expected);
+	}
+	if (result == OVDA_SUCCESS) {
+		ovs_dealias(e);
+	}
+}
+
+void test_indexed_matches_stream() {
+	const char* inputs[] = {
+		"(a b . c)",
+		"(1 (2 (3)) \"x y\" . \"z\")",
+		"'(a 'b) rest",
+		"(a ; comment\n\tb)",
+		"(\"résumé\" 𝄞 x)",
+		"  (a (b",
+		"(a . b c)",
+		""
+	};
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+		check_indexed(inputs[i], strlen(inputs[i]));
+	}
+}
+
+/*
+ * Put whitespace and multibyte characters at each offset around the end
+ * of the first window of the indexed reader, where a window may be cut
+ * short so as not to split a character.
+ */
+void test_indexed_window_boundary() {
+	const int64_t length = 140000;
+	char* s = malloc(length);
+	for (int32_t shift = 0; shift < 8; shift++) {
+		s[0] = '(';
+		for (int64_t i = 1; i < length - 1; i++) {
+			s[i] = i % 2 ? 'a' : ' ';
+		}
+		s[length - 1] = ')';
+
+		int64_t cut = 65536 - shift;
+		memcpy(s + cut - 2, " \xc3\xa9 \xf0\x9d\x84\x9e", 8);
+		check_indexed(s, length);
+
+		memcpy(s + cut - 2, "\xc3\xa9\xf0\x9d\x84\x9e\"\"", 8);
+		check_indexed(s, length);
+	}
+	free(s);
+}
+
+int main() {
+	UNITY_BEGIN();
+
+	RUN_TEST(test_read_long_list);
+	RUN_TEST(test_read_deep_nesting);
+	RUN_TEST(test_read_unclosed_list);
+	RUN_TEST(test_step_in_and_out);
+	RUN_TEST(test_read_empty_string);
+	RUN_TEST(test_feed_bytes);
+	RUN_TEST(test_feed_unfinished);
+	RUN_TEST(test_feed_long_tokens);
+	RUN_TEST(test_indexed_matches_stream);
+	RUN_TEST(test_indexed_window_boundary);
+
+	return UNITY_END();
+}
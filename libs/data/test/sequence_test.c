@@ -0,0 +1,193 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/ucnv.h>
+
+#include "c-ohvu/io/stringref.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#define POOL_SIZE 8
+#define MAX_LENGTH 6000
+#define ROUNDS 3000
+
+/*
+ * A sequence alongside a plain array of what it should hold.
+ */
+typedef struct modelled {
+	ovs_expr sequence;
+	int64_t* model;
+	uint32_t length;
+} modelled;
+
+static ovs_context* context;
+static uint64_t seed;
+static modelled pool[POOL_SIZE];
+
+void setUp() {
+	context = ovs_init();
+	seed = 88172645463325252ull;
+	for (int i = 0; i < POOL_SIZE; i++) {
+		pool[i].sequence = ovs_sequence(0, NULL);
+		pool[i].model = malloc(sizeof(int64_t) * MAX_LENGTH);
+		pool[i].length = 0;
+	}
+}
+
+void tearDown() {
+	for (int i = 0; i < POOL_SIZE; i++) {
+		ovs_dealias(pool[i].sequence);
+		free(pool[i].model);
+	}
+	ovs_close(context);
+}
+
+uint32_t next_random(uint32_t bound) {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return bound == 0 ? 0 : (uint32_t)(seed % bound);
+}
+
+void replace(modelled* m, ovs_expr s) {
+	ovs_dealias(m->sequence);
+	m->sequence = s;
+}
+
+bool matches(const modelled* m) {
+	if (ovs_sequence_length(m->sequence) != m->length) {
+		return false;
+	}
+	ovs_sequence_iterator it;
+	ovs_sequence_iterate(m->sequence, &it);
+	ovs_expr e;
+	for (uint32_t i = 0; i < m->length; i++) {
+		if (!ovs_sequence_next(&it, &e) || e.integer != m->model[i]) {
+			return false;
+		}
+	}
+	if (ovs_sequence_next(&it, &e)) {
+		return false;
+	}
+	for (int k = 0; k < 4 && m->length > 0; k++) {
+		uint32_t i = next_random(m->length);
+		e = ovs_sequence_index(m->sequence, i);
+		if (e.integer != m->model[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Random concatenations, slices, updates and pushes among a pool of
+ * sequences, each checked against its model along with every other
+ * sequence in the pool, which the operations must leave alone. Pieces of
+ * uneven length make the concatenations build relaxed nodes.
+ */
+void test_operations_match_model() {
+	int64_t next_value = 0;
+	int32_t wrong = 0;
+	bool relaxed = false;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		modelled* m = &pool[next_random(POOL_SIZE)];
+		modelled* other = &pool[next_random(POOL_SIZE)];
+
+		switch (next_random(4)) {
+			case 0:
+				if (m->length + other->length <= MAX_LENGTH) {
+					ovs_expr s = ovs_sequence_concat(m->sequence, other->sequence);
+					memmove(m->model + m->length, other->model, sizeof(int64_t) * other->length);
+					m->length += other->length;
+					replace(m, s);
+					relaxed |= m->sequence.p->sequence.relaxed;
+				}
+				break;
+
+			case 1:
+				;
+				uint32_t from = next_random(other->length + 1);
+				uint32_t to = from + next_random(other->length - from + 1);
+				ovs_expr s = ovs_sequence_slice(other->sequence, from, to);
+				memmove(m->model, other->model + from, sizeof(int64_t) * (to - from));
+				m->length = to - from;
+				replace(m, s);
+				break;
+
+			case 2:
+				if (m->length > 0) {
+					uint32_t i = next_random(m->length);
+					replace(m, ovs_sequence_update(m->sequence, i, ovs_integer(next_value)));
+					m->model[i] = next_value++;
+				}
+				break;
+
+			case 3:
+				;
+				uint32_t n = next_random(100);
+				for (uint32_t i = 0; i < n && m->length < MAX_LENGTH; i++) {
+					ovs_sequence_push(&m->sequence, ovs_integer(next_value));
+					m->model[m->length++] = next_value++;
+				}
+				break;
+		}
+
+		for (int i = 0; i < POOL_SIZE; i++) {
+			wrong += !matches(&pool[i]);
+		}
+	}
+
+	TEST_ASSERT_EQUAL_INT32(0, wrong);
+	TEST_ASSERT_TRUE(relaxed);
+}
+
+/*
+ * A sequence built up by concatenation equals and hashes the same as one
+ * built at once from the same elements.
+ */
+void test_equality_of_shapes() {
+	ovs_expr elements[1000];
+	for (int i = 0; i < 1000; i++) {
+		elements[i] = ovs_integer(i);
+	}
+	ovs_expr whole = ovs_sequence(1000, elements);
+
+	ovs_expr built = ovs_sequence(0, NULL);
+	for (uint32_t from = 0; from < 1000;) {
+		uint32_t to = from + 1 + next_random(70);
+		to = to > 1000 ? 1000 : to;
+		ovs_expr piece = ovs_sequence(to - from, elements + from);
+		ovs_expr s = ovs_sequence_concat(built, piece);
+		ovs_dealias(piece);
+		ovs_dealias(built);
+		built = s;
+		from = to;
+	}
+
+	TEST_ASSERT_TRUE(ovs_is_eq(whole, built));
+	TEST_ASSERT_EQUAL(ovs_hash(whole), ovs_hash(built));
+
+	ovs_expr changed = ovs_sequence_update(built, 999, ovs_integer(-1));
+	TEST_ASSERT_TRUE(!ovs_is_eq(whole, changed));
+
+	ovs_dealias(changed);
+	ovs_dealias(built);
+	ovs_dealias(whole);
+}
+
+int main() {
+	UNITY_BEGIN();
+
+	RUN_TEST(test_operations_match_model);
+	RUN_TEST(test_equality_of_shapes);
+
+	return UNITY_END();
+}
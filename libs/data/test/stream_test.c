@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utf.h>
+#include <unicode/utypes.h>
+#include <unicode/ustdio.h>
+
+#include "c-ohvu/io/stream.h"
+
+#define UNIT_COUNT 140000
+
+static char path[32];
+static UChar* units;
+
+void setUp() {
+	strcpy(path, "/tmp/stream-test-XXXXXX");
+	close(mkstemp(path));
+
+	units = malloc(sizeof(UChar) * UNIT_COUNT);
+	for (int32_t i = 0; i < UNIT_COUNT; i++) {
+		units[i] = u'a' + i % 26;
+	}
+}
+
+void tearDown() {
+	unlink(path);
+	free(units);
+}
+
+void write_file(const void* bytes, size_t length) {
+	FILE* f = fopen(path, "wb");
+	fwrite(bytes, 1, length, f);
+	fclose(f);
+}
+
+/*
+ * Write the units after a byte order mark, in native order or swapped.
+ */
+void write_units(bool swapped) {
+	UChar* bytes = malloc(sizeof(UChar) * (UNIT_COUNT + 1));
+	bytes[0] = 0xfeff;
+	memcpy(bytes + 1, units, sizeof(UChar) * UNIT_COUNT);
+	if (swapped) {
+		for (int32_t i = 0; i <= UNIT_COUNT; i++) {
+			bytes[i] = bytes[i] << 8 | bytes[i] >> 8;
+		}
+	}
+	write_file(bytes, sizeof(UChar) * (UNIT_COUNT + 1));
+	free(bytes);
+}
+
+/*
+ * Read each block and free it before taking the next, as the scanner
+ * does, checking that no block splits a surrogate pair.
+ */
+void check_units() {
+	ovio_stream* s = ovio_open_mmap_stream(path);
+	TEST_ASSERT_TRUE(s != NULL);
+
+	int64_t length = 0;
+	bool same = true;
+	ovio_block* b;
+	while ((b = s->next_block(s)) != NULL) {
+		TEST_ASSERT_EQUAL(OVIO_UTF16, b->encoding);
+		int64_t n = b->end - b->start;
+		TEST_ASSERT_TRUE(n > 0 && length + n <= UNIT_COUNT);
+		TEST_ASSERT_TRUE(!U16_IS_LEAD(b->end[-1]) || length + n == UNIT_COUNT);
+		same = same && !memcmp(units + length, b->start, sizeof(UChar) * n);
+		length += n;
+		s->free_block(s, b);
+	}
+	ovio_close_stream(s);
+
+	TEST_ASSERT_EQUAL_INT64(UNIT_COUNT, length);
+	TEST_ASSERT_TRUE(same);
+}
+
+void test_read_utf8() {
+	// a four byte sequence across the first cut, after a byte order mark
+	char* bytes = malloc(UNIT_COUNT);
+	memset(bytes, 'a', UNIT_COUNT);
+	memcpy(bytes, "\xef\xbb\xbf", 3);
+	memcpy(bytes + 65534, "\xf0\x9d\x84\x9e", 4);
+	write_file(bytes, UNIT_COUNT);
+
+	ovio_stream* s = ovio_open_mmap_stream(path);
+	TEST_ASSERT_TRUE(s != NULL);
+
+	int64_t length = 3;
+	bool same = true;
+	ovio_block* b;
+	while ((b = s->next_block(s)) != NULL) {
+		TEST_ASSERT_EQUAL(OVIO_UTF8, b->encoding);
+		int64_t n = b->utf8_end - b->utf8_start;
+		TEST_ASSERT_TRUE(n > 0 && length + n <= UNIT_COUNT);
+		TEST_ASSERT_TRUE(length + n == UNIT_COUNT || !U8_IS_TRAIL(bytes[length + n]));
+		same = same && !memcmp(bytes + length, b->utf8_start, n);
+		length += n;
+		s->free_block(s, b);
+	}
+	ovio_close_stream(s);
+
+	TEST_ASSERT_EQUAL_INT64(UNIT_COUNT, length);
+	TEST_ASSERT_TRUE(same);
+	free(bytes);
+}
+
+void test_read_utf16() {
+	units[65534] = 0xd834;
+	units[65535] = 0xdd1e;
+	write_units(false);
+	check_units();
+}
+
+/*
+ * The first block is cut short of the largest size and the second keeps
+ * a surrogate pair whole, so the second is longer than the buffer freed
+ * by the first.
+ */
+void test_read_swapped_utf16() {
+	units[131069] = 0xd834;
+	units[131070] = 0xdd1e;
+	write_units(true);
+	check_units();
+}
+
+void test_read_empty() {
+	write_file("", 0);
+	ovio_stream* s = ovio_open_mmap_stream(path);
+	TEST_ASSERT_TRUE(s != NULL);
+	TEST_ASSERT_TRUE(s->next_block(s) == NULL);
+	ovio_close_stream(s);
+}
+
+int main() {
+	UNITY_BEGIN();
+
+	RUN_TEST(test_read_utf8);
+	RUN_TEST(test_read_utf16);
+	RUN_TEST(test_read_swapped_utf16);
+	RUN_TEST(test_read_empty);
+
+	return UNITY_END();
+}
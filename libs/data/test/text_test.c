@@ -0,0 +1,271 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <uchar.h>
+#include <unicode/utypes.h>
+#include <unicode/utf16.h>
+#include <unicode/ucnv.h>
+#include <unicode/ustring.h>
+
+#include "c-ohvu/io/stringref.h"
+
+#include "c-ohvu/data/bdtrie.h"
+#include "c-ohvu/data/sexpr.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OVS_TEXT_AVX2
+#endif
+
+// the kernels of text.c
+uint32_t find_units(const UChar* s, uint32_t n, const UChar* p, uint32_t m);
+uint32_t mismatch_units(const UChar* a, const UChar* b, uint32_t n);
+#ifdef OVS_TEXT_AVX2
+uint32_t find_units_avx2(const UChar* s, uint32_t n, const UChar* p, uint32_t m);
+uint32_t mismatch_units_avx2(const UChar* a, const UChar* b, uint32_t n);
+#endif
+
+#define MAX_LENGTH 70
+
+static ovs_context* context;
+static uint64_t seed;
+
+void setUp() {
+	context = ovs_init();
+	seed = 88172645463325252ull;
+}
+
+void tearDown() {
+	ovs_close(context);
+}
+
+uint32_t next_random(uint32_t bound) {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return (uint32_t)(seed % bound);
+}
+
+/*
+ * Units from a small alphabet, so that patterns recur, which includes
+ * both halves of surrogate pairs and units either side of them.
+ */
+void fill_units(UChar* s, uint32_t n) {
+	static const UChar alphabet[] = { u'a', u'b', 0xd800, 0xdbff, 0xdc00, 0xdfff, 0xe000, 0xffff };
+	for (uint32_t i = 0; i < n; i++) {
+		s[i] = alphabet[next_random(sizeof(alphabet) / sizeof(alphabet[0]))];
+	}
+}
+
+bool has_chars(ovs_expr s, uint32_t l, const UChar* expected) {
+	uint32_t length;
+	const UChar* chars = ovs_string_chars(&s, &length);
+	return length == l && !memcmp(chars, expected, sizeof(UChar) * l);
+}
+
+int32_t sign(int32_t x) {
+	return (x > 0) - (x < 0);
+}
+
+#ifdef OVS_TEXT_AVX2
+
+/*
+ * Every length up to a few vectors, with matches and mismatches at every
+ * position including the tail.
+ */
+void test_avx2_matches_portable() {
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2")) {
+		return;
+	}
+
+	UChar a[MAX_LENGTH];
+	UChar b[MAX_LENGTH];
+	for (int round = 0; round < 20; round++) {
+		for (uint32_t n = 0; n <= MAX_LENGTH; n++) {
+			fill_units(a, n);
+			memcpy(b, a, sizeof(UChar) * n);
+			if (n > 0 && round % 2) {
+				b[next_random(n)] ^= 1;
+			}
+			TEST_ASSERT_EQUAL_INT32(mismatch_units(a, b, n), mismatch_units_avx2(a, b, n));
+
+			for (uint32_t m = 1; m <= 5 && m <= n; m++) {
+				UChar p[5];
+				fill_units(p, m);
+				TEST_ASSERT_EQUAL_INT32(find_units(a, n, p, m), find_units_avx2(a, n, p, m));
+			}
+		}
+	}
+}
+
+#endif
+
+void test_find() {
+	UChar chars[MAX_LENGTH];
+	fill_units(chars, MAX_LENGTH);
+	ovs_expr s = ovs_string(MAX_LENGTH, chars);
+
+	int32_t wrong = 0;
+	for (uint32_t m = 0; m <= 3; m++) {
+		for (int k = 0; k < 20; k++) {
+			UChar p[3];
+			fill_units(p, m);
+			ovs_expr pattern = ovs_string(m, p);
+			for (uint32_t from = 0; from <= MAX_LENGTH + 1; from++) {
+				uint32_t expected = from;
+				while (expected + m <= MAX_LENGTH && memcmp(chars + expected, p, sizeof(UChar) * m)) {
+					expected++;
+				}
+				bool should_find = from <= MAX_LENGTH && expected + m <= MAX_LENGTH;
+
+				uint32_t index;
+				bool found = ovs_string_find(s, pattern, from, &index);
+				wrong += found != should_find || (found && index != expected);
+			}
+			ovs_dealias(pattern);
+		}
+	}
+	TEST_ASSERT_EQUAL_INT32(0, wrong);
+
+	ovs_dealias(s);
+}
+
+/*
+ * Code points either side of the surrogates, as units or pairs, and
+ * surrogates on their own, which pair up when a lead meets a trail.
+ */
+uint32_t encode_code_points(UChar* s, const uint32_t* picks, uint32_t n) {
+	static const UChar32 alphabet[] = { u'a', 0xd7ff, 0xe000, 0xffff, 0x10000, 0x10ffff, 0xd800, 0xdbff, 0xdc00, 0xdfff };
+	uint32_t length = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		U16_APPEND_UNSAFE(s, length, alphabet[picks[i] % (sizeof(alphabet) / sizeof(alphabet[0]))]);
+	}
+	return length;
+}
+
+/*
+ * Code point order as ICU has it, for strings mixing surrogate pairs,
+ * lone surrogates and the units above them.
+ */
+void test_compare_in_code_point_order() {
+	uint32_t pa[8];
+	uint32_t pb[8];
+	UChar a[16];
+	UChar b[16];
+	int32_t wrong = 0;
+	for (int k = 0; k < 100000; k++) {
+		uint32_t na = next_random(8);
+		uint32_t nb = next_random(8);
+		uint32_t common = next_random((na < nb ? na : nb) + 1);
+		for (uint32_t i = 0; i < 8; i++) {
+			pa[i] = next_random(10);
+			pb[i] = i < common ? pa[i] : next_random(10);
+		}
+		uint32_t la = encode_code_points(a, pa, na);
+		uint32_t lb = encode_code_points(b, pb, nb);
+
+		ovs_expr x = ovs_string(la, a);
+		ovs_expr y = ovs_string(lb, b);
+		int32_t expected = sign(u_strCompare(a, la, b, lb, true));
+		wrong += sign(ovs_string_compare(x, y)) != expected;
+		wrong += sign(ovs_string_compare(y, x)) != -expected;
+		ovs_dealias(y);
+		ovs_dealias(x);
+	}
+	TEST_ASSERT_EQUAL_INT32(0, wrong);
+}
+
+void test_split() {
+	ovs_table* t = &context->root_tables[OVS_UNQUALIFIED];
+	const struct {
+		const UChar* string;
+		const UChar* separator;
+		int32_t count;
+		const UChar* pieces[4];
+	} cases[] = {
+		{ u"a,,bc,", u",", 4, { u"a", u"", u"bc", u"" } },
+		{ u"one::two:three", u"::", 2, { u"one", u"two:three" } },
+		{ u"", u",", 1, { u"" } },
+		{ u"no separator here", u";", 1, { u"no separator here" } },
+		{ u"::::", u"::", 3, { u"", u"", u"" } }
+	};
+
+	for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+		ovs_expr s = ovs_string(u_strlen(cases[k].string), (UChar*)cases[k].string);
+		ovs_expr separator = ovs_string(u_strlen(cases[k].separator), (UChar*)cases[k].separator);
+		ovs_expr l = ovs_string_split(t, s, separator);
+
+		ovs_expr pieces[4];
+		TEST_ASSERT_EQUAL_INT32(cases[k].count, ovs_list_length(t, l));
+		ovs_delist_into(t, l, cases[k].count, pieces);
+		for (int32_t i = 0; i < cases[k].count; i++) {
+			TEST_ASSERT_TRUE(has_chars(pieces[i], u_strlen(cases[k].pieces[i]), cases[k].pieces[i]));
+			ovs_dealias(pieces[i]);
+		}
+
+		ovs_dealias(l);
+		ovs_dealias(separator);
+		ovs_dealias(s);
+	}
+}
+
+/*
+ * Whichever way a string is made, it is short exactly when it fits, so
+ * that strings which are equal have the same representation.
+ */
+void test_short_strings() {
+	UChar chars[MAX_LENGTH];
+	fill_units(chars, MAX_LENGTH);
+
+	for (uint32_t n = 0; n <= 8; n++) {
+		ovs_string_builder b;
+		ovs_string_builder_init(&b);
+		for (uint32_t i = 0; i < n;) {
+			uint32_t l = 1 + next_random(n - i);
+			ovs_string_builder_append(&b, l, chars + i);
+			i += l;
+		}
+		ovs_expr built = ovs_string_builder_finish(&b);
+		ovs_expr direct = ovs_string(n, chars);
+
+		TEST_ASSERT_EQUAL(n <= OVS_SHORT_STRING_MAX ? OVS_SHORT_STRING : OVS_STRING, built.type);
+		TEST_ASSERT_EQUAL(direct.type, built.type);
+		TEST_ASSERT_TRUE(has_chars(built, n, chars));
+		TEST_ASSERT_TRUE(ovs_is_eq(direct, built));
+		TEST_ASSERT_EQUAL(ovs_hash(direct), ovs_hash(built));
+
+		ovs_dealias(direct);
+		ovs_dealias(built);
+	}
+
+	ovs_expr s = ovs_string(MAX_LENGTH, chars);
+	int32_t wrong = 0;
+	for (uint32_t from = 0; from <= MAX_LENGTH; from++) {
+		for (uint32_t to = from; to <= MAX_LENGTH; to++) {
+			ovs_expr sub = ovs_substring(s, from, to);
+			ovs_expr_type expected = to - from <= OVS_SHORT_STRING_MAX ? OVS_SHORT_STRING : OVS_STRING;
+			wrong += sub.type != expected || !has_chars(sub, to - from, chars + from);
+			ovs_dealias(sub);
+		}
+	}
+	TEST_ASSERT_EQUAL_INT32(0, wrong);
+	ovs_dealias(s);
+}
+
+int main() {
+	UNITY_BEGIN();
+
+#ifdef OVS_TEXT_AVX2
+	RUN_TEST(test_avx2_matches_portable);
+#endif
+	RUN_TEST(test_find);
+	RUN_TEST(test_compare_in_code_point_order);
+	RUN_TEST(test_split);
+	RUN_TEST(test_short_strings);
+
+	return UNITY_END();
+}
@@ -3,9 +3,16 @@ typedef struct ovio_page {
 	struct ovio_page* next;
 } ovio_page;
 
+/**
+ * Positions count UTF-16 code units whatever the encoding of the blocks,
+ * since that is what the buffer is taken as.
+ */
 typedef struct ovio_cursor {
 	ovio_page* page;
-	const UChar* address;
+	union {
+		const UChar* address;
+		const uint8_t* utf8_address;
+	};
 	int64_t position;
 } ovio_cursor;
 
@@ -19,6 +26,17 @@ typedef struct ovio_scanner {
 	ovio_stream* stream;
 } ovio_scanner;
 
+/**
+ * A class of characters, given by up to eight ASCII characters which
+ * are either its only members or, if complement is set, the only
+ * characters it excludes.
+ */
+typedef struct ovio_class {
+	bool complement;
+	uint8_t count;
+	char characters[8];
+} ovio_class;
+
 ovio_scanner* ovio_open_scanner(ovio_stream* s);
 
 void ovio_close_scanner(ovio_scanner* s);
@@ -29,6 +47,25 @@ int64_t ovio_buffer_position(ovio_scanner* s);
 
 int64_t ovio_advance_input_while(ovio_scanner* s, bool (*condition)(UChar32 c, const void* context), const void* context);
 
+int64_t ovio_advance_input_while_class(ovio_scanner* s, const ovio_class* c);
+
+bool ovio_class_has(const ovio_class* c, UChar32 character);
+
+/**
+ * The next character of input, without advancing over it, or U_SENTINEL
+ * at the end of input or a malformed sequence.
+ */
+UChar32 ovio_peek_input(ovio_scanner* s);
+
+bool ovio_advance_input(ovio_scanner* s);
+
+/**
+ * Whether the scanner has looked past the input for another character and
+ * found the end of the stream, so that what it scanned last might have
+ * gone on had the stream been longer.
+ */
+bool ovio_seen_end_of_input(ovio_scanner* s);
+
 bool ovio_advance_input_if(ovio_scanner* s, bool (*condition)(UChar32 c, const void* context), const void* context);
 
 int64_t ovio_take_buffer_to(ovio_scanner* s, int64_t p, UChar* t);
@@ -37,6 +74,14 @@ int64_t ovio_take_buffer_length(ovio_scanner* s, int64_t l, UChar* t);
 
 int64_t ovio_take_buffer(ovio_scanner* s, UChar* t);
 
+/**
+ * Take the next l units of the buffer without copying them, if they lie
+ * within a single page of UTF-16, and return where they are. They remain
+ * valid until the buffer next moves. Otherwise return NULL and leave the
+ * buffer where it was, and the units must be taken by copying.
+ */
+const UChar* ovio_borrow_buffer_length(ovio_scanner* s, int64_t l);
+
 int64_t ovio_discard_buffer_to(ovio_scanner* s, int64_t p);
 
 int64_t ovio_discard_buffer_length(ovio_scanner* s, int64_t l);
@@ -1,6 +1,25 @@
+typedef enum ovio_encoding {
+	OVIO_UTF16,
+	OVIO_UTF8
+} ovio_encoding;
+
+/**
+ * A block of UTF-16 code units, or of UTF-8 bytes which the scanner
+ * decodes as it goes. A block of UTF-8 must not end part way through a
+ * multibyte sequence.
+ */
 typedef struct ovio_block {
-	const UChar* start;
-	const UChar* end;
+	ovio_encoding encoding;
+	union {
+		struct {
+			const UChar* start;
+			const UChar* end;
+		};
+		struct {
+			const uint8_t* utf8_start;
+			const uint8_t* utf8_end;
+		};
+	};
 } ovio_block;
 
 /**
@@ -26,6 +45,7 @@ typedef struct ovio_stream {
 } ovio_stream;
 
 ovio_stream* ovio_open_file_stream(UFILE* f);
+ovio_stream* ovio_open_mmap_stream(const char* path);
 ovio_stream* ovio_open_string_stream(const char* s);
 ovio_stream* ovio_open_nstring_stream(const char* s, int64_t l);
 ovio_stream* ovio_open_ustring_stream(const UChar* s);
@@ -14,6 +14,10 @@
 #include "c-ohvu/io/stream.h"
 #include "c-ohvu/io/scanner.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 const UChar32 MALFORMED = 0xE000;
 const UChar32 EOS = 0xE001;
 
@@ -51,20 +55,52 @@ int64_t ovio_buffer_position(scanner* s) {
 	return s->buffer.position;
 }
 
+page* open_page(scanner* s) {
+	page* p = malloc(sizeof(page));
+	p->block = s->stream->next_block(s->stream);
+	p->next = NULL;
+	return p;
+}
+
+void start_page(ovio_cursor* c) {
+	const ovio_block* b = c->page->block;
+	if (b == NULL) {
+		c->address = NULL;
+	} else if (b->encoding == OVIO_UTF8) {
+		c->utf8_address = b->utf8_start;
+	} else {
+		c->address = b->start;
+	}
+}
+
+bool at_end_of_page(const ovio_cursor* c) {
+	const ovio_block* b = c->page->block;
+	if (b == NULL) {
+		return true;
+	}
+	return b->encoding == OVIO_UTF8
+		? c->utf8_address == b->utf8_end
+		: c->address == b->end;
+}
+
+/*
+ * A cursor stays on a page it has reached the end of until the next
+ * address is needed, so that the pages from the buffer to the next
+ * address always form a chain. The page after the last block holds no
+ * block, and its address is NULL. Empty blocks are passed over.
+ */
 void prepare_next_address(scanner* s) {
 	if (s->next.page == NULL) {
-		s->next.page = malloc(sizeof(page));
-		s->next.page->block = s->stream->next_block(s->stream);
-		s->next.page->next = NULL;
-		if (s->next.page->block != NULL) {
-			s->next.address = s->next.page->block->start;
-		}
-		if (s->input.page != NULL) {
-			s->input.page->next = s->next.page;
-		} else {
-			s->input = s->next;
-			s->buffer = s->next;
-		}
+		s->next.page = open_page(s);
+		start_page(&s->next);
+		s->input = s->next;
+		s->buffer = s->next;
+	}
+	while (s->next.address != NULL && at_end_of_page(&s->next)) {
+		page* p = open_page(s);
+		s->next.page->next = p;
+		s->next.page = p;
+		start_page(&s->next);
 	}
 }
 
@@ -72,13 +108,37 @@ UChar advance_next_address(scanner* s) {
 	UChar c = *s->next.address;
 	s->next.position++;
 	s->next.address++;
-	if (s->next.address == s->next.page->block->end) {
-		s->next.page = NULL;
-		s->next.address = NULL;
-	}
 	return c;
 }
 
+/*
+ * Blocks of UTF-8 never split a sequence, so a character is always
+ * decoded from a single block. An ill-formed sequence is consumed as one
+ * malformed character.
+ */
+void prepare_next_utf8_character(scanner* s) {
+	const uint8_t* p = s->next.utf8_address;
+	if (*p < 0x80) {
+		s->next.utf8_address++;
+		s->next.position++;
+		s->next_character = *p;
+		return;
+	}
+
+	int32_t i = 0;
+	int32_t n = s->next.page->block->utf8_end - p;
+	UChar32 c;
+	U8_NEXT(p, i, n, c);
+	s->next.utf8_address += i;
+	if (c < 0) {
+		s->next.position++;
+		s->next_character = MALFORMED;
+		return;
+	}
+	s->next.position += U16_LENGTH(c);
+	s->next_character = c;
+}
+
 void prepare_next_character(scanner* s) {
 	if (s->next.position != s->input.position) {
 		return;
@@ -91,6 +151,11 @@ void prepare_next_character(scanner* s) {
 		return;
 	}
 
+	if (s->next.page->block->encoding == OVIO_UTF8) {
+		prepare_next_utf8_character(s);
+		return;
+	}
+
 	UChar c1 = advance_next_address(s);
 	if (U16_IS_TRAIL(c1)) {
 		s->next_character = MALFORMED;
@@ -128,6 +193,163 @@ int64_t ovio_advance_input_while(scanner* s, bool (*condition)(UChar32 c, const
 	return s->input.position - from;
 }
 
+bool ovio_class_has(const ovio_class* c, UChar32 character) {
+	if (character < 0x80) {
+		for (int i = 0; i < c->count; i++) {
+			if (c->characters[i] == character) {
+				return !c->complement;
+			}
+		}
+	}
+	return c->complement;
+}
+
+#ifdef __SSE2__
+
+/*
+ * Sixteen bytes or eight units at a time, a run of ASCII members of the
+ * class is passed over with one compare per listed character. Anything
+ * else ends the run and is left to be decoded.
+ */
+
+int64_t skip_utf8_class(ovio_cursor* cursor, const ovio_class* c) {
+	const uint8_t* p = cursor->utf8_address;
+	const uint8_t* end = cursor->page->block->utf8_end;
+
+	while (end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i listed = _mm_setzero_si128();
+		for (int i = 0; i < c->count; i++) {
+			listed = _mm_or_si128(listed, _mm_cmpeq_epi8(v, _mm_set1_epi8(c->characters[i])));
+		}
+		uint32_t stop = _mm_movemask_epi8(listed);
+		if (!c->complement) {
+			stop = ~stop & 0xffff;
+		}
+		stop |= _mm_movemask_epi8(v);
+		if (stop != 0) {
+			p += __builtin_ctz(stop);
+			break;
+		}
+		p += 16;
+	}
+
+	int64_t n = p - cursor->utf8_address;
+	cursor->utf8_address = p;
+	cursor->position += n;
+	return n;
+}
+
+int64_t skip_utf16_class(ovio_cursor* cursor, const ovio_class* c) {
+	const UChar* p = cursor->address;
+	const UChar* end = cursor->page->block->end;
+	const __m128i high = _mm_set1_epi16((short)0xff80);
+
+	while (end - p >= 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i listed = _mm_setzero_si128();
+		for (int i = 0; i < c->count; i++) {
+			listed = _mm_or_si128(listed, _mm_cmpeq_epi16(v, _mm_set1_epi16(c->characters[i])));
+		}
+		uint32_t stop = _mm_movemask_epi8(listed);
+		if (!c->complement) {
+			stop = ~stop & 0xffff;
+		}
+		__m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, high), _mm_setzero_si128());
+		stop |= ~_mm_movemask_epi8(ascii) & 0xffff;
+		if (stop != 0) {
+			p += __builtin_ctz(stop) / 2;
+			break;
+		}
+		p += 8;
+	}
+
+	int64_t n = p - cursor->address;
+	cursor->address = p;
+	cursor->position += n;
+	return n;
+}
+
+#else
+
+int64_t skip_utf8_class(ovio_cursor* cursor, const ovio_class* c) {
+	const uint8_t* p = cursor->utf8_address;
+	const uint8_t* end = cursor->page->block->utf8_end;
+	while (p < end && *p < 0x80 && ovio_class_has(c, *p)) {
+		p++;
+	}
+	int64_t n = p - cursor->utf8_address;
+	cursor->utf8_address = p;
+	cursor->position += n;
+	return n;
+}
+
+int64_t skip_utf16_class(ovio_cursor* cursor, const ovio_class* c) {
+	const UChar* p = cursor->address;
+	const UChar* end = cursor->page->block->end;
+	while (p < end && *p < 0x80 && ovio_class_has(c, *p)) {
+		p++;
+	}
+	int64_t n = p - cursor->address;
+	cursor->address = p;
+	cursor->position += n;
+	return n;
+}
+
+#endif
+
+/*
+ * Where nothing has been looked ahead at, the input and the next address
+ * move together over whole runs of the block; past the end of a run the
+ * next character is decoded and tested as usual.
+ */
+int64_t ovio_advance_input_while_class(scanner* s, const ovio_class* c) {
+	int64_t from = s->input.position;
+	while (true) {
+		if (s->next.position == s->input.position) {
+			prepare_next_address(s);
+			if (s->next.address != NULL) {
+				bool skipped = s->next.page->block->encoding == OVIO_UTF8
+					? skip_utf8_class(&s->next, c)
+					: skip_utf16_class(&s->next, c);
+				if (skipped) {
+					advance_next_character(s);
+					continue;
+				}
+			}
+		}
+
+		prepare_next_character(s);
+		if (s->next_character == EOS ||
+				s->next_character == MALFORMED ||
+				!ovio_class_has(c, s->next_character)) {
+			break;
+		}
+		advance_next_character(s);
+	}
+	return s->input.position - from;
+}
+
+UChar32 ovio_peek_input(scanner* s) {
+	prepare_next_character(s);
+	if (s->next_character == EOS || s->next_character == MALFORMED) {
+		return U_SENTINEL;
+	}
+	return s->next_character;
+}
+
+bool ovio_seen_end_of_input(scanner* s) {
+	return s->next.position != s->input.position && s->next_character == EOS;
+}
+
+bool ovio_advance_input(scanner* s) {
+	if (ovio_peek_input(s) == U_SENTINEL) {
+		return false;
+	}
+	advance_next_character(s);
+	return true;
+}
+
 bool ovio_advance_input_if(scanner* s, bool (*condition)(UChar32 c, const void* v), const void* context) {
 	prepare_next_character(s);
 	if (s->next_character != EOS &&
@@ -148,37 +370,120 @@ bool advance_buffer_page(scanner* s) {
 	page* next = s->buffer.page->next;
 	free(s->buffer.page);
 	s->buffer.page = next;
-	if (s->buffer.page->block != NULL) {
-		s->buffer.address = s->buffer.page->block->start;
-	} else {
-		s->buffer.address = NULL;
-	}
+	start_page(&s->buffer);
 	return true;
 }
 
-int64_t ovio_take_buffer_to(scanner* s, int64_t p, UChar* b) {
-	int64_t size = p - s->buffer.position;
+/*
+ * Widen up to n units of UTF-8 from the page of a cursor into t, or skip
+ * them if t is NULL. Only bytes the input has already advanced over are
+ * read, so they are known to be well formed. Runs of ASCII go sixteen
+ * bytes at a time where SSE2 is available.
+ */
+int64_t move_utf8_units(ovio_cursor* c, int64_t n, UChar* t) {
+	const uint8_t* p = c->utf8_address;
+	const uint8_t* end = c->page->block->utf8_end;
+	int64_t j = 0;
+
+	while (j < n && p < end) {
+#ifdef __SSE2__
+		while (n - j >= 16 && end - p >= 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			if (_mm_movemask_epi8(v) != 0) {
+				break;
+			}
+			if (t != NULL) {
+				__m128i zero = _mm_setzero_si128();
+				_mm_storeu_si128((__m128i*)(t + j), _mm_unpacklo_epi8(v, zero));
+				_mm_storeu_si128((__m128i*)(t + j + 8), _mm_unpackhi_epi8(v, zero));
+			}
+			p += 16;
+			j += 16;
+		}
+		if (j == n || p == end) {
+			break;
+		}
+#endif
+
+		if (*p < 0x80) {
+			if (t != NULL) {
+				t[j] = *p;
+			}
+			p++;
+			j++;
+			continue;
+		}
+
+		int32_t i = 0;
+		UChar32 ch;
+		U8_NEXT_UNSAFE(p, i, ch);
+		if (U16_LENGTH(ch) > n - j) {
+			break;
+		}
+		if (t != NULL) {
+			U16_APPEND_UNSAFE(t, j, ch);
+		} else {
+			j += U16_LENGTH(ch);
+		}
+		p += i;
+	}
+
+	c->utf8_address = p;
+	return j;
+}
+
+/*
+ * Move a cursor up to n units through its page, copying them to t
+ * unless it is NULL, and return how many it moved.
+ */
+int64_t move_units(ovio_cursor* c, int64_t n, UChar* t) {
+	if (c->page == NULL || c->page->block == NULL) {
+		return 0;
+	}
+	if (c->page->block->encoding == OVIO_UTF8) {
+		return move_utf8_units(c, n, t);
+	}
+
+	int64_t available = c->page->block->end - c->address;
+	if (available < n) {
+		n = available;
+	}
+	if (t != NULL) {
+		memcpy(t, c->address, n * sizeof(UChar));
+	}
+	c->address += n;
+	return n;
+}
+
+/*
+ * A buffer of UTF-8 only moves by whole characters, so it may stop one
+ * unit short of a position within a surrogate pair.
+ */
+int64_t move_buffer_to(scanner* s, int64_t p, UChar* b) {
 	if (p > s->input.position) {
 		p = s->input.position;
 	}
+	int64_t size = p - s->buffer.position;
 	if (size < 0) {
 		return size;
 	}
 	int64_t remaining = size;
-	int64_t available = s->buffer.page->block->end - s->buffer.address;
-	while (available < remaining) {
-		memcpy(b, s->buffer.address, available * sizeof(UChar));
-		b += available;
-		remaining -= available;
-		
-		advance_buffer_page(s);
-		available = s->buffer.page->block->end - s->buffer.address;
-	}
-	memcpy(b, s->buffer.address, remaining * sizeof(UChar));
-	b += remaining;
-	s->buffer.address += remaining;
-	s->buffer.position = p;
-	return size;
+	while (true) {
+		int64_t n = move_units(&s->buffer, remaining, b);
+		if (b != NULL) {
+			b += n;
+		}
+		remaining -= n;
+		if (remaining == 0 || !at_end_of_page(&s->buffer) || !advance_buffer_page(s)) {
+			break;
+		}
+	}
+	s->buffer.position = p - remaining;
+	return size - remaining;
+}
+
+int64_t ovio_take_buffer_to(scanner* s, int64_t p, UChar* b) {
+	return move_buffer_to(s, p, b);
 }
 
 int64_t ovio_take_buffer_length(scanner* s, int64_t l, UChar* b) {
@@ -189,24 +494,28 @@ int64_t ovio_take_buffer(scanner* s, UChar* b) {
 	return ovio_take_buffer_to(s, ovio_input_position(s), b);
 }
 
-int64_t ovio_discard_buffer_to(scanner* s, int64_t p) {
-	int64_t size = p - s->buffer.position;
-	if (p > s->input.position) {
-		p = s->input.position;
+/*
+ * Borrowing never crosses a page, so a buffer left at the end of one page
+ * moves on to the next before looking for l units in it.
+ */
+const UChar* ovio_borrow_buffer_length(scanner* s, int64_t l) {
+	if (s->buffer.page == NULL || l > s->input.position - s->buffer.position) {
+		return NULL;
 	}
-	if (size < 0) {
-		return size;
+	while (at_end_of_page(&s->buffer) && advance_buffer_page(s));
+
+	const ovio_block* b = s->buffer.page->block;
+	if (b == NULL || b->encoding != OVIO_UTF16 || b->end - s->buffer.address < l) {
+		return NULL;
 	}
-	int64_t remaining = size;
-	int64_t available = s->buffer.page->block->end - s->buffer.address;
-	while (available < remaining) {
-		remaining -= available;
-		advance_buffer_page(s);
-		available = s->buffer.page->block->end - s->buffer.address;
-	}
-	s->buffer.address += remaining;
-	s->buffer.position = p;
-	return size;
+	const UChar* span = s->buffer.address;
+	s->buffer.address += l;
+	s->buffer.position += l;
+	return span;
+}
+
+int64_t ovio_discard_buffer_to(scanner* s, int64_t p) {
+	return move_buffer_to(s, p, NULL);
 }
 
 int64_t ovio_discard_buffer_length(scanner* s, int64_t l) {
@@ -222,11 +531,14 @@ int64_t ovio_discard_buffer(scanner* s) {
 
 void ovio_close_scanner(scanner* s) {
 	ovio_discard_buffer(s);
-	if (s->input.page != NULL) {
-		if (s->input.page->block != NULL) {
-			s->stream->free_block(s->stream, s->input.page->block);
+	page* p = s->input.page;
+	while (p != NULL) {
+		if (p->block != NULL) {
+			s->stream->free_block(s->stream, p->block);
 		}
-		free(s->input.page);
+		page* next = p->next;
+		free(p);
+		p = next;
 	}
 	free(s);
 }
@@ -2,6 +2,10 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <uchar.h>
 #include <unicode/utf.h>
@@ -43,6 +47,7 @@ block* next_ustring_block(stream* ss) {
 	}
 
 	block* b = malloc(sizeof(block));
+	b->encoding = OVIO_UTF16;
 	b->start = uss->start;
 	b->end = uss->end;
 
@@ -59,7 +64,7 @@ void close_ustring_stream(stream* s) {
 	free(s);
 }
 
-stream* open_ustring_stream(const UChar* s) {
+stream* ovio_open_ustring_stream(const UChar* s) {
 	stream* ss = malloc(sizeof(stream) + sizeof(ustring_stream));
 	ustring_stream* uss = (ustring_stream*)(ss + 1);
 
@@ -73,8 +78,8 @@ stream* open_ustring_stream(const UChar* s) {
 	return ss;
 }
 
-stream* open_nustring_stream(const UChar* s, int64_t l) {
-	stream* ss = open_ustring_stream(s);
+stream* ovio_open_nustring_stream(const UChar* s, int64_t l) {
+	stream* ss = ovio_open_ustring_stream(s);
 	ustring_stream* uss = (ustring_stream*)(ss + 1);
 
 	uss->end = s + l;
@@ -82,6 +87,69 @@ stream* open_nustring_stream(const UChar* s, int64_t l) {
 	return ss;
 }
 
+/*
+ * string
+ *
+ * UTF-8, handed to the scanner undecoded.
+ */
+
+typedef struct string_stream {
+	const uint8_t* start;
+	const uint8_t* end;
+} string_stream;
+
+block* next_string_block(stream* ss) {
+	string_stream* sss = (string_stream*)(ss + 1);
+
+	if (sss->start == NULL) {
+		return NULL;
+	}
+
+	if (sss->end == NULL) {
+		sss->end = sss->start + strlen((const char*)sss->start);
+	}
+
+	block* b = malloc(sizeof(block));
+	b->encoding = OVIO_UTF8;
+	b->utf8_start = sss->start;
+	b->utf8_end = sss->end;
+
+	sss->start = NULL;
+
+	return b;
+}
+
+void free_string_block(stream* s, block* b) {
+	free(b);
+}
+
+void close_string_stream(stream* s) {
+	free(s);
+}
+
+stream* ovio_open_string_stream(const char* s) {
+	stream* ss = malloc(sizeof(stream) + sizeof(string_stream));
+	string_stream* sss = (string_stream*)(ss + 1);
+
+	ss->next_block = next_string_block;
+	ss->free_block = free_string_block;
+	ss->close = close_string_stream;
+
+	sss->start = (const uint8_t*)s;
+	sss->end = NULL;
+
+	return ss;
+}
+
+stream* ovio_open_nstring_stream(const char* s, int64_t l) {
+	stream* ss = ovio_open_string_stream(s);
+	string_stream* sss = (string_stream*)(ss + 1);
+
+	sss->end = (const uint8_t*)s + l;
+
+	return ss;
+}
+
 /*
  * file
  */
@@ -105,6 +173,7 @@ block* next_file_block(stream* s) {
 	}
 	
 	block* b = malloc(sizeof(block));
+	b->encoding = OVIO_UTF16;
 	b->start = c;
 	b->end = c + size;
 
@@ -132,3 +201,207 @@ stream* ovio_open_file_stream(UFILE* f) {
 
 	return s;
 }
+
+/*
+ * mmap
+ *
+ * A file mapped into memory. UTF-8, which is what a file is taken to be
+ * without a byte order mark saying otherwise, and UTF-16 in native order
+ * are presented straight from the mapping, so the scanner decodes them in
+ * place. Byte swapped UTF-16 is swapped into buffers which are reused
+ * once freed, since the scanner only holds a few blocks at a time.
+ * Buffers are no larger than the block they are first taken for, so
+ * opening a small file costs little.
+ */
+
+#define MMAP_BLOCK_SIZE 65536
+
+typedef enum mmap_encoding {
+	MMAP_UTF8,
+	MMAP_UTF16,
+	MMAP_UTF16_SWAPPED
+} mmap_encoding;
+
+typedef struct mmap_buffer {
+	block block; // first, so a block from a buffer is the buffer
+	struct mmap_buffer* next;
+	int64_t capacity;
+	UChar units[]; // variable length
+} mmap_buffer;
+
+typedef struct mmap_stream {
+	const uint8_t* bytes;
+	int64_t size;
+	int64_t position;
+	mmap_encoding encoding;
+	mmap_buffer* free_buffers;
+} mmap_stream;
+
+/*
+ * A buffer for up to capacity units. A block may be one unit longer than
+ * the one before it, to keep a surrogate pair whole, so a freed buffer
+ * which is too small is given up for a new one.
+ */
+mmap_buffer* take_mmap_buffer(mmap_stream* ms, int64_t capacity) {
+	mmap_buffer* buffer = ms->free_buffers;
+	if (buffer != NULL) {
+		ms->free_buffers = buffer->next;
+		if (buffer->capacity < capacity) {
+			free(buffer);
+			buffer = NULL;
+		}
+	}
+	if (buffer == NULL) {
+		buffer = malloc(sizeof(mmap_buffer) + sizeof(UChar) * capacity);
+		buffer->capacity = capacity;
+	}
+	buffer->next = NULL;
+	return buffer;
+}
+
+/*
+ * Blocks end before any multibyte sequence they would otherwise split.
+ * An ill-formed sequence may still be cut, but the scanner stops at the
+ * first byte of it either way.
+ */
+block* next_mmap_utf8_block(mmap_stream* ms) {
+	const uint8_t* start = ms->bytes + ms->position;
+	int64_t remaining = ms->size - ms->position;
+	if (remaining == 0) {
+		return NULL;
+	}
+
+	int64_t n = remaining;
+	if (n > MMAP_BLOCK_SIZE) {
+		n = MMAP_BLOCK_SIZE;
+		for (int i = 0; i < 3 && U8_IS_TRAIL(start[n]); i++) {
+			n--;
+		}
+	}
+	ms->position += n;
+
+	block* b = malloc(sizeof(block));
+	b->encoding = OVIO_UTF8;
+	b->utf8_start = start;
+	b->utf8_end = start + n;
+	return b;
+}
+
+block* next_mmap_block(stream* s) {
+	mmap_stream* ms = (mmap_stream*)(s + 1);
+
+	if (ms->encoding == MMAP_UTF8) {
+		return next_mmap_utf8_block(ms);
+	}
+
+	// a trailing odd byte is not part of any unit
+	const UChar* start = (const UChar*)(ms->bytes + ms->position);
+	int64_t remaining = (ms->size - ms->position) / sizeof(UChar);
+	if (remaining == 0) {
+		return NULL;
+	}
+
+	int64_t n = remaining < MMAP_BLOCK_SIZE ? remaining : MMAP_BLOCK_SIZE - 1;
+	UChar last = ms->encoding == MMAP_UTF16 ? start[n - 1] : (UChar)(start[n - 1] << 8 | start[n - 1] >> 8);
+	if (n < remaining && U16_IS_LEAD(last)) {
+		n++;
+	}
+	ms->position += n * sizeof(UChar);
+
+	if (ms->encoding == MMAP_UTF16) {
+		block* b = malloc(sizeof(block));
+		b->encoding = OVIO_UTF16;
+		b->start = start;
+		b->end = start + n;
+		return b;
+	}
+
+	mmap_buffer* buffer = take_mmap_buffer(ms, n);
+	for (int64_t i = 0; i < n; i++) {
+		buffer->units[i] = start[i] << 8 | start[i] >> 8;
+	}
+	buffer->block.encoding = OVIO_UTF16;
+	buffer->block.start = buffer->units;
+	buffer->block.end = buffer->units + n;
+	return &buffer->block;
+}
+
+void free_mmap_block(stream* s, block* b) {
+	mmap_stream* ms = (mmap_stream*)(s + 1);
+
+	if (ms->encoding != MMAP_UTF16_SWAPPED) {
+		free(b);
+		return;
+	}
+
+	mmap_buffer* buffer = (mmap_buffer*)b;
+	buffer->next = ms->free_buffers;
+	ms->free_buffers = buffer;
+}
+
+void close_mmap_stream(stream* s) {
+	mmap_stream* ms = (mmap_stream*)(s + 1);
+
+	if (ms->size > 0) {
+		munmap((void*)ms->bytes, ms->size);
+	}
+	while (ms->free_buffers != NULL) {
+		mmap_buffer* next = ms->free_buffers->next;
+		free(ms->free_buffers);
+		ms->free_buffers = next;
+	}
+	free(s);
+}
+
+/*
+ * Returns NULL if the file cannot be opened or mapped.
+ */
+stream* ovio_open_mmap_stream(const char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	void* bytes = NULL;
+	if (st.st_size > 0) {
+		bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (bytes == MAP_FAILED) {
+			close(fd);
+			return NULL;
+		}
+		madvise(bytes, st.st_size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	stream* s = malloc(sizeof(stream) + sizeof(mmap_stream));
+	mmap_stream* ms = (mmap_stream*)(s + 1);
+
+	s->next_block = next_mmap_block;
+	s->free_block = free_mmap_block;
+	s->close = close_mmap_stream;
+
+	ms->bytes = bytes;
+	ms->size = st.st_size;
+	ms->position = 0;
+	ms->encoding = MMAP_UTF8;
+	ms->free_buffers = NULL;
+
+	const uint8_t* b = bytes;
+	if (ms->size >= 2 && *(const UChar*)b == 0xfeff) {
+		ms->encoding = MMAP_UTF16;
+		ms->position = 2;
+	} else if (ms->size >= 2 && *(const UChar*)b == 0xfffe) {
+		ms->encoding = MMAP_UTF16_SWAPPED;
+		ms->position = 2;
+	} else if (ms->size >= 3 && b[0] == 0xef && b[1] == 0xbb && b[2] == 0xbf) {
+		ms->position = 3;
+	}
+
+	return s;
+}
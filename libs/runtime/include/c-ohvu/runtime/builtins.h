@@ -4,8 +4,76 @@ ovs_expr ovru_cons(ovs_context* c, ovs_table* t);
 
 ovs_expr ovru_des(ovs_context* c, ovs_table* t);
 
+ovs_expr ovru_concat(ovs_context* c);
+
+ovs_expr ovru_substring(ovs_context* c);
+
+ovs_expr ovru_find(ovs_context* c);
+
+ovs_expr ovru_split(ovs_context* c);
+
 ovs_expr ovru_eq(ovs_context* c);
 
+ovs_expr ovru_add(ovs_context* c);
+
+ovs_expr ovru_sub(ovs_context* c);
+
+ovs_expr ovru_mul(ovs_context* c);
+
+ovs_expr ovru_divmod(ovs_context* c);
+
+ovs_expr ovru_compare(ovs_context* c);
+
+ovs_expr ovru_array(ovs_context* c);
+
+ovs_expr ovru_float_array(ovs_context* c);
+
+ovs_expr ovru_array_add(ovs_context* c);
+
+ovs_expr ovru_array_sub(ovs_context* c);
+
+ovs_expr ovru_array_mul(ovs_context* c);
+
+ovs_expr ovru_array_dot(ovs_context* c);
+
+ovs_expr ovru_array_sum(ovs_context* c);
+
+ovs_expr ovru_array_min(ovs_context* c);
+
+ovs_expr ovru_array_max(ovs_context* c);
+
+ovs_expr ovru_array_prefix_sum(ovs_context* c);
+
+ovs_expr ovru_blob(ovs_context* c);
+
+ovs_expr ovru_decode(ovs_context* c);
+
+ovs_expr ovru_map(ovs_context* c);
+
+ovs_expr ovru_map_insert(ovs_context* c);
+
+ovs_expr ovru_map_lookup(ovs_context* c);
+
+ovs_expr ovru_map_remove(ovs_context* c);
+
+ovs_expr ovru_map_entries(ovs_context* c);
+
+ovs_expr ovru_sequence(ovs_context* c);
+
+ovs_expr ovru_sequence_update(ovs_context* c);
+
+ovs_expr ovru_sequence_concat(ovs_context* c);
+
+ovs_expr ovru_vector(ovs_context* c, ovs_table* t);
+
+ovs_expr ovru_index(ovs_context* c);
+
+ovs_expr ovru_length(ovs_context* c);
+
+ovs_expr ovru_slice(ovs_context* c);
+
+ovs_expr ovru_map_file(ovs_context* c);
+
 ovs_expr ovru_open_scanner(ovs_context* c, UFILE* file, UChar* file_name);
 
 ovs_expr ovru_open_printer(ovs_context* c, UFILE* file, UChar* file_name);
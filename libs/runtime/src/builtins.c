@@ -5,6 +5,7 @@
 
 #include <unicode/utypes.h>
 #include <unicode/ucnv.h>
+#include <unicode/ustring.h>
 #include <unicode/ustdio.h>
 
 #include "c-ohvu/io/stringref.h"
@@ -132,12 +133,14 @@ int32_t printer_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_dat
 	
 	printer_data* data = ovs_function_extra_data(d);
 
-	if (string.type != OVS_STRING) {
+	if (!ovs_is_string(string)) {
 		i->size = 1;
 		i->values[0] = ovs_alias(fail);
 
 	} else if (data->next == NULL) {
-		u_fprintf(data->file, "%S", &string.p->string);
+		uint32_t length;
+		const UChar* chars = ovs_string_chars(&string, &length);
+		u_file_write(chars, length, data->file);
 
 		printer_data* next_data;
 		data->next = malloc(sizeof(ovs_expr));
@@ -303,6 +306,215 @@ ovs_expr ovru_des(ovs_context* c, ovs_table* t) {
 	return e;
 }
 
+/*
+ * concat
+ */
+
+ovs_function_info concat_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+/*
+ * Concatenate a list of strings, in time linear in their total length.
+ */
+int32_t concat_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_table* t = &d->context->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr list = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr* e;
+	int32_t count = ovs_delist(t, list, &e);
+
+	bool valid = count >= 0;
+	for (int32_t j = 0; j < count && valid; j++) {
+		valid = ovs_is_string(e[j]);
+	}
+
+	if (!valid) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		ovs_string_builder b;
+		ovs_string_builder_init(&b);
+		for (int32_t j = 0; j < count; j++) {
+			ovs_string_builder_append_string(&b, e[j]);
+		}
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_string_builder_finish(&b);
+	}
+
+	for (int32_t j = 0; j < count; j++) {
+		ovs_dealias(e[j]);
+	}
+	if (count > 0) {
+		free(e);
+	}
+
+	return 0;
+}
+
+static ovs_function_type concat_function = {
+	u"concat",
+	no_represent,
+	concat_inspect,
+	concat_apply,
+	no_free
+};
+
+ovs_expr ovru_concat(ovs_context* c) {
+	return ovs_function(c, &concat_function, 0, NULL);
+}
+
+/*
+ * substring
+ */
+
+ovs_function_info substring_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 5, 2 };
+}
+
+int32_t substring_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr s = args[1];
+	ovs_expr from = args[2];
+	ovs_expr to = args[3];
+	ovs_expr fail = args[4];
+	ovs_expr cont = args[5];
+
+	uint32_t length = 0;
+	if (ovs_is_string(s)) {
+		ovs_string_chars(&s, &length);
+	}
+
+	if (!ovs_is_string(s)
+			|| from.type != OVS_INTEGER
+			|| to.type != OVS_INTEGER
+			|| from.integer < 0
+			|| from.integer > to.integer
+			|| to.integer > length) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_substring(s, from.integer, to.integer);
+	}
+
+	return 0;
+}
+
+static ovs_function_type substring_function = {
+	u"substring",
+	no_represent,
+	substring_inspect,
+	substring_apply,
+	no_free
+};
+
+ovs_expr ovru_substring(ovs_context* c) {
+	return ovs_function(c, &substring_function, 0, NULL);
+}
+
+/*
+ * find
+ */
+
+ovs_function_info find_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 5, 2 };
+}
+
+/*
+ * The offset of the first occurrence of a pattern in a string at or after
+ * a given offset, failing if there is none.
+ */
+int32_t find_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr s = args[1];
+	ovs_expr pattern = args[2];
+	ovs_expr from = args[3];
+	ovs_expr fail = args[4];
+	ovs_expr cont = args[5];
+
+	uint32_t index;
+	if (!ovs_is_string(s)
+			|| !ovs_is_string(pattern)
+			|| from.type != OVS_INTEGER
+			|| from.integer < 0
+			|| from.integer > UINT32_MAX
+			|| !ovs_string_find(s, pattern, from.integer, &index)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(index);
+	}
+
+	return 0;
+}
+
+static ovs_function_type find_function = {
+	u"find",
+	no_represent,
+	find_inspect,
+	find_apply,
+	no_free
+};
+
+ovs_expr ovru_find(ovs_context* c) {
+	return ovs_function(c, &find_function, 0, NULL);
+}
+
+/*
+ * split
+ */
+
+ovs_function_info split_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 2 };
+}
+
+int32_t split_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_table* t = &d->context->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr s = args[1];
+	ovs_expr separator = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	uint32_t length = 0;
+	if (ovs_is_string(separator)) {
+		ovs_string_chars(&separator, &length);
+	}
+
+	if (!ovs_is_string(s) || length == 0) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_string_split(t, s, separator);
+	}
+
+	return 0;
+}
+
+static ovs_function_type split_function = {
+	u"split",
+	no_represent,
+	split_inspect,
+	split_apply,
+	no_free
+};
+
+ovs_expr ovru_split(ovs_context* c) {
+	return ovs_function(c, &split_function, 0, NULL);
+}
+
 /*
  * eq
  */
@@ -334,3 +546,1160 @@ static ovs_function_type eq_function = {
 ovs_expr ovru_eq(ovs_context* c) {
 	return ovs_function(c, &eq_function, 0, NULL);
 }
+
+/*
+ * arithmetic
+ */
+
+ovs_function_info arithmetic_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 2 };
+}
+
+int32_t arithmetic_apply(ovs_instruction* i, ovs_expr* args, ovs_expr (*op)(ovs_expr a, ovs_expr b)) {
+	ovs_expr a = args[1];
+	ovs_expr b = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	if (!ovs_is_integer(a) || !ovs_is_integer(b)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = op(a, b);
+	}
+
+	return 0;
+}
+
+int32_t add_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return arithmetic_apply(i, args, ovs_integer_add);
+}
+
+int32_t sub_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return arithmetic_apply(i, args, ovs_integer_sub);
+}
+
+int32_t mul_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return arithmetic_apply(i, args, ovs_integer_mul);
+}
+
+static ovs_function_type add_function = {
+	u"add",
+	no_represent,
+	arithmetic_inspect,
+	add_apply,
+	no_free
+};
+
+static ovs_function_type sub_function = {
+	u"sub",
+	no_represent,
+	arithmetic_inspect,
+	sub_apply,
+	no_free
+};
+
+static ovs_function_type mul_function = {
+	u"mul",
+	no_represent,
+	arithmetic_inspect,
+	mul_apply,
+	no_free
+};
+
+ovs_expr ovru_add(ovs_context* c) {
+	return ovs_function(c, &add_function, 0, NULL);
+}
+
+ovs_expr ovru_sub(ovs_context* c) {
+	return ovs_function(c, &sub_function, 0, NULL);
+}
+
+ovs_expr ovru_mul(ovs_context* c) {
+	return ovs_function(c, &mul_function, 0, NULL);
+}
+
+/*
+ * divmod
+ */
+
+ovs_function_info divmod_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 3 };
+}
+
+int32_t divmod_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr a = args[1];
+	ovs_expr b = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	ovs_expr q;
+	ovs_expr r;
+	if (!ovs_is_integer(a)
+			|| !ovs_is_integer(b)
+			|| !ovs_integer_divmod(a, b, &q, &r)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 3;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = q;
+		i->values[2] = r;
+	}
+
+	return 0;
+}
+
+static ovs_function_type divmod_function = {
+	u"divmod",
+	no_represent,
+	divmod_inspect,
+	divmod_apply,
+	no_free
+};
+
+ovs_expr ovru_divmod(ovs_context* c) {
+	return ovs_function(c, &divmod_function, 0, NULL);
+}
+
+/*
+ * compare
+ */
+
+ovs_function_info compare_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 6, 1 };
+}
+
+int32_t compare_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr a = args[1];
+	ovs_expr b = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr lt = args[4];
+	ovs_expr eq = args[5];
+	ovs_expr gt = args[6];
+
+	i->size = 1;
+	if (ovs_is_integer(a) && ovs_is_integer(b)) {
+		int32_t c = ovs_integer_compare(a, b);
+		i->values[0] = ovs_alias(c < 0 ? lt : c > 0 ? gt : eq);
+
+	} else if (ovs_is_string(a) && ovs_is_string(b)) {
+		int32_t c = ovs_string_compare(a, b);
+		i->values[0] = ovs_alias(c < 0 ? lt : c > 0 ? gt : eq);
+
+	} else {
+		i->values[0] = ovs_alias(fail);
+	}
+
+	return 0;
+}
+
+static ovs_function_type compare_function = {
+	u"compare",
+	no_represent,
+	compare_inspect,
+	compare_apply,
+	no_free
+};
+
+ovs_expr ovru_compare(ovs_context* c) {
+	return ovs_function(c, &compare_function, 0, NULL);
+}
+
+/*
+ * array
+ */
+
+ovs_function_info array_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t array_of_list_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d, ovs_array_kind kind) {
+	ovs_table* t = &d->context->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr list = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr a;
+	if (ovs_array_of_list(t, kind, list, &a) < 0) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = a;
+	}
+
+	return 0;
+}
+
+int32_t array_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_of_list_apply(i, args, d, OVS_INT64_ARRAY);
+}
+
+int32_t float_array_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_of_list_apply(i, args, d, OVS_DOUBLE_ARRAY);
+}
+
+static ovs_function_type array_function = {
+	u"array",
+	no_represent,
+	array_inspect,
+	array_apply,
+	no_free
+};
+
+static ovs_function_type float_array_function = {
+	u"float-array",
+	no_represent,
+	array_inspect,
+	float_array_apply,
+	no_free
+};
+
+ovs_expr ovru_array(ovs_context* c) {
+	return ovs_function(c, &array_function, 0, NULL);
+}
+
+ovs_expr ovru_float_array(ovs_context* c) {
+	return ovs_function(c, &float_array_function, 0, NULL);
+}
+
+/*
+ * array operations
+ */
+
+ovs_function_info array_binary_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 2 };
+}
+
+int32_t array_binary_apply(ovs_instruction* i, ovs_expr* args, bool (*op)(ovs_expr a, ovs_expr b, ovs_expr* r)) {
+	ovs_expr a = args[1];
+	ovs_expr b = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	ovs_expr r;
+	if (!op(a, b, &r)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = r;
+	}
+
+	return 0;
+}
+
+ovs_function_info array_unary_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t array_unary_apply(ovs_instruction* i, ovs_expr* args, bool (*op)(ovs_expr a, ovs_expr* r)) {
+	ovs_expr a = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr r;
+	if (!op(a, &r)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = r;
+	}
+
+	return 0;
+}
+
+int32_t array_add_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_binary_apply(i, args, ovs_array_add);
+}
+
+int32_t array_sub_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_binary_apply(i, args, ovs_array_sub);
+}
+
+int32_t array_mul_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_binary_apply(i, args, ovs_array_mul);
+}
+
+int32_t array_dot_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_binary_apply(i, args, ovs_array_dot);
+}
+
+int32_t array_sum_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_unary_apply(i, args, ovs_array_sum);
+}
+
+int32_t array_min_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_unary_apply(i, args, ovs_array_min);
+}
+
+int32_t array_max_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_unary_apply(i, args, ovs_array_max);
+}
+
+int32_t array_prefix_sum_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	return array_unary_apply(i, args, ovs_array_prefix_sum);
+}
+
+static ovs_function_type array_add_function = {
+	u"array-add",
+	no_represent,
+	array_binary_inspect,
+	array_add_apply,
+	no_free
+};
+
+static ovs_function_type array_sub_function = {
+	u"array-sub",
+	no_represent,
+	array_binary_inspect,
+	array_sub_apply,
+	no_free
+};
+
+static ovs_function_type array_mul_function = {
+	u"array-mul",
+	no_represent,
+	array_binary_inspect,
+	array_mul_apply,
+	no_free
+};
+
+static ovs_function_type array_dot_function = {
+	u"array-dot",
+	no_represent,
+	array_binary_inspect,
+	array_dot_apply,
+	no_free
+};
+
+static ovs_function_type array_sum_function = {
+	u"array-sum",
+	no_represent,
+	array_unary_inspect,
+	array_sum_apply,
+	no_free
+};
+
+static ovs_function_type array_min_function = {
+	u"array-min",
+	no_represent,
+	array_unary_inspect,
+	array_min_apply,
+	no_free
+};
+
+static ovs_function_type array_max_function = {
+	u"array-max",
+	no_represent,
+	array_unary_inspect,
+	array_max_apply,
+	no_free
+};
+
+static ovs_function_type array_prefix_sum_function = {
+	u"array-prefix-sum",
+	no_represent,
+	array_unary_inspect,
+	array_prefix_sum_apply,
+	no_free
+};
+
+ovs_expr ovru_array_add(ovs_context* c) {
+	return ovs_function(c, &array_add_function, 0, NULL);
+}
+
+ovs_expr ovru_array_sub(ovs_context* c) {
+	return ovs_function(c, &array_sub_function, 0, NULL);
+}
+
+ovs_expr ovru_array_mul(ovs_context* c) {
+	return ovs_function(c, &array_mul_function, 0, NULL);
+}
+
+ovs_expr ovru_array_dot(ovs_context* c) {
+	return ovs_function(c, &array_dot_function, 0, NULL);
+}
+
+ovs_expr ovru_array_sum(ovs_context* c) {
+	return ovs_function(c, &array_sum_function, 0, NULL);
+}
+
+ovs_expr ovru_array_min(ovs_context* c) {
+	return ovs_function(c, &array_min_function, 0, NULL);
+}
+
+ovs_expr ovru_array_max(ovs_context* c) {
+	return ovs_function(c, &array_max_function, 0, NULL);
+}
+
+ovs_expr ovru_array_prefix_sum(ovs_context* c) {
+	return ovs_function(c, &array_prefix_sum_function, 0, NULL);
+}
+
+/*
+ * blob
+ */
+
+ovs_function_info blob_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t blob_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_table* t = &d->context->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr list = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr* e;
+	int32_t count = ovs_delist(t, list, &e);
+
+	uint8_t* bytes = malloc(count > 0 ? count : 1);
+	bool valid = count >= 0;
+	for (int32_t j = 0; j < count; j++) {
+		if (e[j].type != OVS_INTEGER || e[j].integer < 0 || e[j].integer > UINT8_MAX) {
+			valid = false;
+		} else {
+			bytes[j] = e[j].integer;
+		}
+		ovs_dealias(e[j]);
+	}
+	if (count > 0) {
+		free(e);
+	}
+
+	if (!valid) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_blob(count, bytes);
+	}
+
+	free(bytes);
+
+	return 0;
+}
+
+static ovs_function_type blob_function = {
+	u"blob",
+	no_represent,
+	blob_inspect,
+	blob_apply,
+	no_free
+};
+
+ovs_expr ovru_blob(ovs_context* c) {
+	return ovs_function(c, &blob_function, 0, NULL);
+}
+
+/*
+ * decode
+ */
+
+ovs_function_info decode_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t decode_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr b = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr s;
+	if (!ovs_is_blob(b) || !ovs_blob_decode(b, &s)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = s;
+	}
+
+	return 0;
+}
+
+static ovs_function_type decode_function = {
+	u"decode",
+	no_represent,
+	decode_inspect,
+	decode_apply,
+	no_free
+};
+
+ovs_expr ovru_decode(ovs_context* c) {
+	return ovs_function(c, &decode_function, 0, NULL);
+}
+
+/*
+ * map file
+ */
+
+ovs_function_info map_file_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t map_file_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr path = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr b;
+	bool mapped = false;
+	if (ovs_is_string(path)) {
+		uint32_t length;
+		const UChar* chars = ovs_string_chars(&path, &length);
+
+		UErrorCode error = U_ZERO_ERROR;
+		int32_t size;
+		u_strToUTF8(NULL, 0, &size, chars, length, &error);
+
+		char* name = malloc(size + 1);
+		error = U_ZERO_ERROR;
+		u_strToUTF8(name, size + 1, NULL, chars, length, &error);
+		mapped = U_SUCCESS(error) && ovs_blob_map_file(name, &b);
+		free(name);
+	}
+
+	if (!mapped) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = b;
+	}
+
+	return 0;
+}
+
+static ovs_function_type map_file_function = {
+	u"map-file",
+	no_represent,
+	map_file_inspect,
+	map_file_apply,
+	no_free
+};
+
+ovs_expr ovru_map_file(ovs_context* c) {
+	return ovs_function(c, &map_file_function, 0, NULL);
+}
+
+/*
+ * map
+ */
+
+ovs_function_info map_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+/*
+ * Build a map from an association list of key value pairs.
+ */
+int32_t map_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_table* t = &d->context->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr list = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr* e;
+	int32_t count = ovs_delist(t, list, &e);
+
+	ovs_expr m = ovs_map();
+	bool valid = count >= 0;
+	for (int32_t j = 0; j < count; j++) {
+		if (valid && !ovs_is_atom(t, e[j])) {
+			ovs_expr key = ovs_car(e[j]);
+			ovs_expr value = ovs_cdr(e[j]);
+			ovs_expr next = ovs_map_insert(m, key, value);
+			ovs_dealias(key);
+			ovs_dealias(value);
+			ovs_dealias(m);
+			m = next;
+		} else {
+			valid = false;
+		}
+		ovs_dealias(e[j]);
+	}
+	if (count > 0) {
+		free(e);
+	}
+
+	if (!valid) {
+		ovs_dealias(m);
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = m;
+	}
+
+	return 0;
+}
+
+static ovs_function_type map_function = {
+	u"map",
+	no_represent,
+	map_inspect,
+	map_apply,
+	no_free
+};
+
+ovs_expr ovru_map(ovs_context* c) {
+	return ovs_function(c, &map_function, 0, NULL);
+}
+
+/*
+ * map insert
+ */
+
+ovs_function_info map_insert_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 5, 2 };
+}
+
+int32_t map_insert_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr m = args[1];
+	ovs_expr key = args[2];
+	ovs_expr value = args[3];
+	ovs_expr fail = args[4];
+	ovs_expr cont = args[5];
+
+	if (!ovs_is_map(m)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_map_insert(m, key, value);
+	}
+
+	return 0;
+}
+
+static ovs_function_type map_insert_function = {
+	u"map-insert",
+	no_represent,
+	map_insert_inspect,
+	map_insert_apply,
+	no_free
+};
+
+ovs_expr ovru_map_insert(ovs_context* c) {
+	return ovs_function(c, &map_insert_function, 0, NULL);
+}
+
+/*
+ * map lookup
+ */
+
+ovs_function_info map_lookup_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 2 };
+}
+
+int32_t map_lookup_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr m = args[1];
+	ovs_expr key = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	ovs_expr value;
+	if (!ovs_is_map(m) || !ovs_map_lookup(m, key, &value)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = value;
+	}
+
+	return 0;
+}
+
+static ovs_function_type map_lookup_function = {
+	u"map-lookup",
+	no_represent,
+	map_lookup_inspect,
+	map_lookup_apply,
+	no_free
+};
+
+ovs_expr ovru_map_lookup(ovs_context* c) {
+	return ovs_function(c, &map_lookup_function, 0, NULL);
+}
+
+/*
+ * map remove
+ */
+
+ovs_function_info map_remove_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 2 };
+}
+
+int32_t map_remove_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr m = args[1];
+	ovs_expr key = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	if (!ovs_is_map(m)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_map_remove(m, key);
+	}
+
+	return 0;
+}
+
+static ovs_function_type map_remove_function = {
+	u"map-remove",
+	no_represent,
+	map_remove_inspect,
+	map_remove_apply,
+	no_free
+};
+
+ovs_expr ovru_map_remove(ovs_context* c) {
+	return ovs_function(c, &map_remove_function, 0, NULL);
+}
+
+/*
+ * map entries
+ */
+
+ovs_function_info map_entries_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+/*
+ * The entries of a map as an association list, in no particular order.
+ */
+int32_t map_entries_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_table* t = &d->context->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr m = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	if (!ovs_is_map(m)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+		return 0;
+	}
+
+	ovs_expr* entries = malloc(sizeof(ovs_expr) * (ovs_map_count(m) + 1));
+	uint32_t count = 0;
+	ovs_map_iterator iterator;
+	ovs_map_iterate(m, &iterator);
+	ovs_expr key;
+	ovs_expr value;
+	while (ovs_map_next(&iterator, &key, &value)) {
+		entries[count++] = ovs_cons(t, key, value);
+	}
+
+	i->size = 2;
+	i->values[0] = ovs_alias(cont);
+	i->values[1] = ovs_list(t, count, entries);
+
+	for (uint32_t j = 0; j < count; j++) {
+		ovs_dealias(entries[j]);
+	}
+	free(entries);
+
+	return 0;
+}
+
+static ovs_function_type map_entries_function = {
+	u"map-entries",
+	no_represent,
+	map_entries_inspect,
+	map_entries_apply,
+	no_free
+};
+
+ovs_expr ovru_map_entries(ovs_context* c) {
+	return ovs_function(c, &map_entries_function, 0, NULL);
+}
+
+/*
+ * sequence
+ */
+
+ovs_function_info sequence_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t sequence_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_table* t = &d->context->root_tables[OVS_UNQUALIFIED];
+
+	ovs_expr list = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr s;
+	if (ovs_sequence_of_list(t, list, &s) < 0) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = s;
+	}
+
+	return 0;
+}
+
+static ovs_function_type sequence_function = {
+	u"sequence",
+	no_represent,
+	sequence_inspect,
+	sequence_apply,
+	no_free
+};
+
+ovs_expr ovru_sequence(ovs_context* c) {
+	return ovs_function(c, &sequence_function, 0, NULL);
+}
+
+/*
+ * sequence update
+ */
+
+ovs_function_info sequence_update_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 5, 2 };
+}
+
+int32_t sequence_update_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr s = args[1];
+	ovs_expr n = args[2];
+	ovs_expr value = args[3];
+	ovs_expr fail = args[4];
+	ovs_expr cont = args[5];
+
+	if (!ovs_is_sequence(s)
+			|| n.type != OVS_INTEGER
+			|| n.integer < 0
+			|| n.integer >= ovs_sequence_length(s)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_sequence_update(s, n.integer, value);
+	}
+
+	return 0;
+}
+
+static ovs_function_type sequence_update_function = {
+	u"sequence-update",
+	no_represent,
+	sequence_update_inspect,
+	sequence_update_apply,
+	no_free
+};
+
+ovs_expr ovru_sequence_update(ovs_context* c) {
+	return ovs_function(c, &sequence_update_function, 0, NULL);
+}
+
+/*
+ * sequence concat
+ */
+
+ovs_function_info sequence_concat_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 2 };
+}
+
+int32_t sequence_concat_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr a = args[1];
+	ovs_expr b = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	if (!ovs_is_sequence(a) || !ovs_is_sequence(b)) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_sequence_concat(a, b);
+	}
+
+	return 0;
+}
+
+static ovs_function_type sequence_concat_function = {
+	u"sequence-concat",
+	no_represent,
+	sequence_concat_inspect,
+	sequence_concat_apply,
+	no_free
+};
+
+ovs_expr ovru_sequence_concat(ovs_context* c) {
+	return ovs_function(c, &sequence_concat_function, 0, NULL);
+}
+
+/*
+ * vector
+ */
+
+ovs_function_info vector_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t vector_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_table* t = *(ovs_table**)ovs_function_extra_data(d);
+
+	ovs_expr list = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	ovs_expr v;
+	if (ovs_vector_of_list(t, list, &v) < 0) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = v;
+	}
+
+	return 0;
+}
+
+void vector_free(const void* d) {
+	ovs_table* t = *(ovs_table**)d;
+	if (t->qualifier != NULL) {
+		ovs_free(OVS_SYMBOL, t->qualifier);
+	}
+}
+
+static ovs_function_type vector_function = {
+	u"vector",
+	no_represent,
+	vector_inspect,
+	vector_apply,
+	vector_free
+};
+
+ovs_expr ovru_vector(ovs_context* c, ovs_table* t) {
+	if (t->qualifier != NULL) {
+		ovs_ref(t->qualifier);
+	}
+	ovs_table** data;
+	ovs_expr e = ovs_function(c, &vector_function, sizeof(ovs_table*), (void**)&data);
+	*data = t;
+	return e;
+}
+
+/*
+ * index
+ */
+
+ovs_function_info index_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 4, 2 };
+}
+
+int32_t index_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr v = args[1];
+	ovs_expr n = args[2];
+	ovs_expr fail = args[3];
+	ovs_expr cont = args[4];
+
+	if (n.type != OVS_INTEGER || n.integer < 0) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else if (ovs_is_array(v) && n.integer < ovs_array_length(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_array_index(v, n.integer);
+
+	} else if (ovs_is_blob(v) && (uint64_t)n.integer < ovs_blob_length(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(ovs_blob_bytes(v)[n.integer]);
+
+	} else if (ovs_is_sequence(v) && n.integer < ovs_sequence_length(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_sequence_index(v, n.integer);
+
+	} else if (ovs_is_vector(v) && n.integer < ovs_vector_length(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_vector_index(v, n.integer);
+
+	} else {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+	}
+
+	return 0;
+}
+
+static ovs_function_type index_function = {
+	u"index",
+	no_represent,
+	index_inspect,
+	index_apply,
+	no_free
+};
+
+ovs_expr ovru_index(ovs_context* c) {
+	return ovs_function(c, &index_function, 0, NULL);
+}
+
+/*
+ * length
+ */
+
+ovs_function_info length_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 3, 2 };
+}
+
+int32_t length_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr v = args[1];
+	ovs_expr fail = args[2];
+	ovs_expr cont = args[3];
+
+	if (ovs_is_array(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(ovs_array_length(v));
+
+	} else if (ovs_is_blob(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(ovs_blob_length(v));
+
+	} else if (ovs_is_map(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(ovs_map_count(v));
+
+	} else if (ovs_is_sequence(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(ovs_sequence_length(v));
+
+	} else if (ovs_is_string(v)) {
+		uint32_t length;
+		ovs_string_chars(&v, &length);
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(length);
+
+	} else if (ovs_is_vector(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_integer(ovs_vector_length(v));
+
+	} else {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+	}
+
+	return 0;
+}
+
+static ovs_function_type length_function = {
+	u"length",
+	no_represent,
+	length_inspect,
+	length_apply,
+	no_free
+};
+
+ovs_expr ovru_length(ovs_context* c) {
+	return ovs_function(c, &length_function, 0, NULL);
+}
+
+/*
+ * slice
+ */
+
+ovs_function_info slice_inspect(const ovs_function_data* d) {
+	return (ovs_function_info){ 5, 2 };
+}
+
+int32_t slice_apply(ovs_instruction* i, ovs_expr* args, const ovs_function_data* d) {
+	ovs_expr v = args[1];
+	ovs_expr from = args[2];
+	ovs_expr to = args[3];
+	ovs_expr fail = args[4];
+	ovs_expr cont = args[5];
+
+	if (from.type != OVS_INTEGER
+			|| to.type != OVS_INTEGER
+			|| from.integer < 0
+			|| from.integer > to.integer) {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+
+	} else if (ovs_is_blob(v) && (uint64_t)to.integer <= ovs_blob_length(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_blob_slice(v, from.integer, to.integer);
+
+	} else if (ovs_is_sequence(v) && to.integer <= ovs_sequence_length(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_sequence_slice(v, from.integer, to.integer);
+
+	} else if (ovs_is_vector(v) && to.integer <= ovs_vector_length(v)) {
+		i->size = 2;
+		i->values[0] = ovs_alias(cont);
+		i->values[1] = ovs_vector_slice(v, from.integer, to.integer);
+
+	} else {
+		i->size = 1;
+		i->values[0] = ovs_alias(fail);
+	}
+
+	return 0;
+}
+
+static ovs_function_type slice_function = {
+	u"slice",
+	no_represent,
+	slice_inspect,
+	slice_apply,
+	no_free
+};
+
+ovs_expr ovru_slice(ovs_context* c) {
+	return ovs_function(c, &slice_function, 0, NULL);
+}
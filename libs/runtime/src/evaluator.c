@@ -59,7 +59,7 @@ ovru_result execute_instruction(instruction_slot* next, instruction_slot* curren
 	
 	const ovs_function_data* f = &current->instruction.values[0].p->function;
 
-	ovs_function_info i = f->type->inspect(f + 1);
+	ovs_function_info i = f->type->inspect(f);
 
 	prepare_instruction_slot(next, i.max_result_size);
 